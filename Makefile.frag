@@ -13,9 +13,14 @@ mrproper: clean clean-tests
 info: $(all_targets)
 	"$(PHP_EXECUTABLE)" -d "extension=$(phplibdir)/$(PHP_PECL_EXTENSION).so" --re "$(PHP_PECL_EXTENSION)"
 
+# Run the interception overhead benchmarks against a no-extension baseline
+# (options via BENCH_ARGS, e.g. BENCH_ARGS="--format=json --iterations=1000000")
+bench: $(all_targets)
+	"$(PHP_EXECUTABLE)" "$(srcdir)/bench/run.php" --extension="$(phplibdir)/$(PHP_PECL_EXTENSION).so" $(BENCH_ARGS)
+
 # Generate package.xml file
 package.xml: php_$(PHP_PECL_EXTENSION).h
 	$(PHP_EXECUTABLE) build-packagexml.php
 
 # Declare phony targets (targets that don't represent files)
-.PHONY: all clean install distclean test prof-gen prof-clean prof-use clean-tests mrproper info
\ No newline at end of file
+.PHONY: all clean install distclean test prof-gen prof-clean prof-use clean-tests mrproper info bench
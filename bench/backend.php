@@ -0,0 +1,87 @@
+<?php
+
+/**
+ * Backend comparison benchmark
+ *
+ * Runs the same workload once per interception backend (rayaop.backend=execute_ex|observer)
+ * in a child process and prints the average cost per call in nanoseconds.
+ *
+ * Usage: php bench/backend.php [iterations]
+ * The extension is loaded from modules/rayaop.so unless RAYAOP_EXTENSION is set.
+ */
+
+const BACKENDS = ['execute_ex', 'observer'];
+
+class BenchInterceptor implements Ray\Aop\MethodInterceptorInterface
+{
+    public function intercept(object $object, string $method, array $params): mixed
+    {
+        return call_user_func_array([$object, $method], $params);
+    }
+}
+
+class BenchTarget
+{
+    public function plain(int $a): int
+    {
+        return $a + 1;
+    }
+
+    public function intercepted(int $a): int
+    {
+        return $a + 1;
+    }
+}
+
+function measure(callable $workload, int $iterations): float
+{
+    $start = hrtime(true);
+    $workload($iterations);
+    return (hrtime(true) - $start) / $iterations;
+}
+
+function worker(int $iterations): void
+{
+    method_intercept(BenchTarget::class, 'intercepted', new BenchInterceptor());
+    $target = new BenchTarget();
+
+    $results = [
+        'non_intercepted' => measure(static function (int $n) use ($target): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->plain($i);
+            }
+        }, $iterations),
+        'intercepted' => measure(static function (int $n) use ($target): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->intercepted($i);
+            }
+        }, $iterations),
+    ];
+    echo json_encode($results), "\n";
+}
+
+if (($argv[1] ?? '') === '--worker') {
+    worker((int) $argv[2]);
+    exit(0);
+}
+
+$iterations = (int) ($argv[1] ?? 1000000);
+$extension = getenv('RAYAOP_EXTENSION') ?: __DIR__ . '/../modules/rayaop.so';
+
+printf("%-12s %20s %20s\n", 'backend', 'non_intercepted ns', 'intercepted ns');
+foreach (BACKENDS as $backend) {
+    $command = sprintf(
+        '%s -n -d extension=%s -d rayaop.backend=%s %s --worker %d',
+        escapeshellarg(PHP_BINARY),
+        escapeshellarg($extension),
+        escapeshellarg($backend),
+        escapeshellarg(__FILE__),
+        $iterations
+    );
+    $result = json_decode((string) shell_exec($command), true);
+    if (!is_array($result)) {
+        fprintf(STDERR, "Benchmark failed for backend %s\n", $backend);
+        exit(1);
+    }
+    printf("%-12s %20.1f %20.1f\n", $backend, $result['non_intercepted'], $result['intercepted']);
+}
@@ -0,0 +1,75 @@
+<?php
+
+/**
+ * Persistent registry benchmark
+ *
+ * Serves a bootstrap through the built-in web server (one worker process) that registers N
+ * bindings and calls one intercepted method, either with method_intercept() on every request
+ * or with method_intercept_persistent() on the first request of the worker only. Prints the
+ * bootstrap time of the first request (startup) and the median of the following requests.
+ *
+ * Usage: php bench/persistent.php [bindings] [requests]
+ * The extension is loaded from modules/rayaop.so unless RAYAOP_EXTENSION is set.
+ */
+
+class BenchInterceptor implements Ray\Aop\MethodInterceptorInterface
+{
+    public function intercept(object $object, string $method, array $params): mixed
+    {
+        return call_user_func_array([$object, $method], $params);
+    }
+}
+
+class BenchService0
+{
+    public function run(int $a): int
+    {
+        return $a + 1;
+    }
+}
+
+if (PHP_SAPI === 'cli-server') {
+    // Bootstrap executed for every request
+    $bindings = (int) $_GET['bindings'];
+    $start = hrtime(true);
+    if ($_GET['mode'] === 'request') {
+        $interceptor = new BenchInterceptor();
+        for ($i = 0; $i < $bindings; $i++) {
+            method_intercept("BenchService{$i}", 'run', $interceptor);
+        }
+    } elseif (isset($_GET['first'])) {
+        for ($i = 0; $i < $bindings; $i++) {
+            method_intercept_persistent("BenchService{$i}", 'run', BenchInterceptor::class);
+        }
+    }
+    (new BenchService0())->run(1);
+    echo hrtime(true) - $start;
+    return;
+}
+
+$bindings = (int) ($argv[1] ?? 1000);
+$requests = (int) ($argv[2] ?? 200);
+$extension = getenv('RAYAOP_EXTENSION') ?: __DIR__ . '/../modules/rayaop.so';
+
+printf("%-12s %16s %20s\n", 'mode', 'startup ns', 'median request ns');
+foreach (['request', 'persistent'] as $offset => $mode) {
+    $port = 18080 + $offset;
+    $server = proc_open(
+        [PHP_BINARY, '-n', '-d', 'extension=' . $extension, '-S', "127.0.0.1:{$port}", __FILE__],
+        [1 => ['file', '/dev/null', 'w'], 2 => ['file', '/dev/null', 'w']],
+        $pipes
+    );
+    usleep(300000);
+
+    $timings = [];
+    for ($i = 0; $i < $requests; $i++) {
+        $query = http_build_query(['mode' => $mode, 'bindings' => $bindings] + ($i === 0 ? ['first' => 1] : []));
+        $timings[] = (int) file_get_contents("http://127.0.0.1:{$port}/?{$query}");
+    }
+    proc_terminate($server);
+    proc_close($server);
+
+    $startup = array_shift($timings);
+    sort($timings);
+    printf("%-12s %16d %20d\n", $mode, $startup, $timings[intdiv(count($timings), 2)]);
+}
@@ -0,0 +1,244 @@
+<?php
+
+/**
+ * Interception overhead benchmark suite
+ *
+ * Runs fixed micro-workloads in a child process per configuration and reports the average cost
+ * per call in nanoseconds. The "baseline" configuration runs without the extension, so every
+ * other configuration can be compared against it:
+ *
+ *   baseline      no extension
+ *   execute_ex    rayaop.backend=execute_ex
+ *   observer      rayaop.backend=observer
+ *   lazy          rayaop.backend=execute_ex with rayaop.lazy=1
+ *
+ * The idle_* workloads register nothing, which is where rayaop.lazy removes the hooks and
+ * compiles function calls without resolving them at compile time.
+ *
+ * Each configuration also runs with opcache JIT (tracing) when opcache is available.
+ *
+ * Usage: php bench/run.php [--iterations=N] [--format=table|json] [--extension=path] [--filter=substring]
+ * Also available as "make bench" (pass options with BENCH_ARGS="...").
+ * The JSON format prints one object per line:
+ *   {"config", "jit", "workload", "ns_per_call", "overhead_ns" (against baseline), "iterations"}
+ */
+
+const BACKENDS = ['execute_ex', 'observer'];
+const ARITIES = [0, 4, 16];
+const BINDING_COUNTS = [1000, 10000];
+const TREE_DEPTH = 32;
+
+/**
+ * Workloads: name => iteration divisor
+ *
+ * The divisor keeps the deep call tree within a similar wall time as the micro-workloads.
+ */
+function workloads(): array
+{
+    $workloads = [
+        'idle_function_call' => 1,
+        'empty_method' => 1,
+        'empty_method_intercepted_classic' => 1,
+        'empty_method_intercepted_native' => 1,
+    ];
+    foreach (ARITIES as $arity) {
+        $workloads["args_{$arity}_intercepted_classic"] = 1;
+        $workloads["args_{$arity}_intercepted_native"] = 1;
+    }
+    $workloads['call_tree_depth_' . TREE_DEPTH] = TREE_DEPTH;
+    foreach (BINDING_COUNTS as $count) {
+        $workloads["bindings_{$count}_non_intercepted"] = 1;
+        $workloads["bindings_{$count}_intercepted"] = 1;
+    }
+    return $workloads;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Worker (child process)
+// ---------------------------------------------------------------------------------------------
+
+function defineWorkerClasses(): void
+{
+    if (!interface_exists('Ray\Aop\MethodInterceptorInterface')) {
+        // Baseline: the classic interceptor must still compile
+        eval('namespace Ray\Aop; interface MethodInterceptorInterface { public function intercept(object $object, string $method, array $params): mixed; }');
+    }
+
+    $methods = '';
+    foreach (ARITIES as $arity) {
+        $params = $arity === 0 ? '' : implode(', ', array_map(static fn (int $i): string => "\$a{$i}", range(1, $arity)));
+        $methods .= "public function args{$arity}({$params}) { return null; }\n";
+    }
+    eval("class BenchTarget {
+        public function emptyMethod() { return null; }
+        public function emptyClassic() { return null; }
+        public function emptyNative() { return null; }
+        {$methods}
+        public function tree(int \$depth) { return \$depth === 0 ? 0 : \$this->tree(\$depth - 1); }
+    }");
+    // Declared and called in one compilation unit, so the call can be resolved at compile time
+    eval('function benchIdle($a) { return $a; }
+        function benchIdleLoop(int $n) { for ($i = 0; $i < $n; $i++) { benchIdle($i); } }');
+    eval('class BenchClassicInterceptor implements Ray\Aop\MethodInterceptorInterface {
+        public function intercept(object $object, string $method, array $params): mixed {
+            return $object->$method(...$params);
+        }
+    }');
+    if (class_exists('Ray\Aop\NativeMethodInvocation', false)) {
+        eval('class BenchNativeInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+            public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+                return $invocation->proceed();
+            }
+        }');
+    }
+}
+
+function registerBindings(int $count): void
+{
+    // Registered classes do not need to exist: the registry only stores names
+    $interceptor = new BenchClassicInterceptor();
+    for ($i = 0; $i < $count; $i++) {
+        method_intercept("BenchRegistered{$i}", 'run', $interceptor);
+    }
+}
+
+function measure(callable $loop, int $iterations, int $calls): float
+{
+    $loop(intdiv($iterations, 10) ?: 1); // Warm up (and let the JIT compile the loop)
+    $start = hrtime(true);
+    $loop($iterations);
+    return (hrtime(true) - $start) / ($iterations * $calls);
+}
+
+function worker(string $workload, int $iterations): void
+{
+    defineWorkerClasses();
+    $extension = function_exists('method_intercept');
+    $target = new BenchTarget();
+
+    if ($extension && strpos($workload, 'idle_') !== 0) {
+        method_intercept(BenchTarget::class, 'emptyClassic', new BenchClassicInterceptor());
+        if (class_exists('BenchNativeInterceptor', false)) {
+            method_intercept(BenchTarget::class, 'emptyNative', new BenchNativeInterceptor());
+        }
+    }
+
+    if ($workload === 'idle_function_call') {
+        $ns = measure('benchIdleLoop', $iterations, 1);
+    } elseif (preg_match('/^args_(\d+)_intercepted_(classic|native)$/', $workload, $m)) {
+        $method = "args{$m[1]}";
+        if ($extension) {
+            method_intercept(BenchTarget::class, $method, $m[2] === 'native' ? new BenchNativeInterceptor() : new BenchClassicInterceptor());
+        }
+        $args = array_fill(0, (int) $m[1], 1);
+        $ns = measure(static function (int $n) use ($target, $method, $args): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->$method(...$args);
+            }
+        }, $iterations, 1);
+    } elseif (preg_match('/^bindings_(\d+)_(non_intercepted|intercepted)$/', $workload, $m)) {
+        if ($extension) {
+            registerBindings((int) $m[1]);
+        }
+        $method = $m[2] === 'intercepted' ? 'emptyClassic' : 'emptyMethod';
+        $ns = measure(static function (int $n) use ($target, $method): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->$method();
+            }
+        }, $iterations, 1);
+    } elseif ($workload === 'call_tree_depth_' . TREE_DEPTH) {
+        $ns = measure(static function (int $n) use ($target): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->tree(TREE_DEPTH);
+            }
+        }, $iterations, TREE_DEPTH + 1);
+    } else {
+        $method = [
+            'empty_method' => 'emptyMethod',
+            'empty_method_intercepted_classic' => 'emptyClassic',
+            'empty_method_intercepted_native' => 'emptyNative',
+        ][$workload];
+        $ns = measure(static function (int $n) use ($target, $method): void {
+            for ($i = 0; $i < $n; $i++) {
+                $target->$method();
+            }
+        }, $iterations, 1);
+    }
+
+    echo json_encode(['ns_per_call' => round($ns, 2)]), "\n";
+}
+
+if (($argv[1] ?? '') === '--worker') {
+    worker($argv[2], (int) $argv[3]);
+    exit(0);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Runner
+// ---------------------------------------------------------------------------------------------
+
+$options = getopt('', ['iterations:', 'format:', 'extension:', 'filter:']);
+$iterations = (int) ($options['iterations'] ?? 200000);
+$format = $options['format'] ?? 'table';
+$extension = $options['extension'] ?? (getenv('RAYAOP_EXTENSION') ?: __DIR__ . '/../modules/rayaop.so');
+$filter = $options['filter'] ?? '';
+
+if (!is_file($extension)) {
+    fprintf(STDERR, "Extension not found: %s (build it first or pass --extension)\n", $extension);
+    exit(1);
+}
+
+$opcache = trim((string) shell_exec(escapeshellarg(PHP_BINARY) . ' -n -d zend_extension=opcache -r "echo function_exists(\'opcache_get_status\') ? 1 : 0;" 2>/dev/null')) === '1';
+$jitModes = $opcache ? [false, true] : [false];
+
+$configs = ['baseline' => []];
+foreach (BACKENDS as $backend) {
+    $configs[$backend] = ['extension' => $extension, 'rayaop.backend' => $backend];
+}
+$configs['lazy'] = ['extension' => $extension, 'rayaop.backend' => 'execute_ex', 'rayaop.lazy' => '1'];
+
+if ($format === 'table') {
+    printf("%-40s %-12s %-5s %12s %12s\n", 'workload', 'config', 'jit', 'ns/call', 'vs baseline');
+}
+foreach (workloads() as $workload => $divisor) {
+    if ($filter !== '' && strpos($workload, $filter) === false) {
+        continue;
+    }
+    foreach ($jitModes as $jit) {
+        $baseline = null;
+        foreach ($configs as $config => $ini) {
+            if ($jit) {
+                $ini += ['zend_extension' => 'opcache', 'opcache.enable_cli' => '1', 'opcache.jit' => 'tracing', 'opcache.jit_buffer_size' => '64M'];
+            }
+            $command = escapeshellarg(PHP_BINARY) . ' -n';
+            foreach ($ini as $name => $value) {
+                $command .= ' -d ' . escapeshellarg("{$name}={$value}");
+            }
+            $workloadIterations = intdiv($iterations, $divisor) ?: 1;
+            $command .= sprintf(' %s --worker %s %d', escapeshellarg(__FILE__), escapeshellarg($workload), $workloadIterations);
+
+            $result = json_decode((string) shell_exec($command), true);
+            if (!is_array($result)) {
+                fprintf(STDERR, "Benchmark %s failed for %s%s\n", $workload, $config, $jit ? ' (JIT)' : '');
+                exit(1);
+            }
+
+            $ns = $result['ns_per_call'];
+            $baseline ??= $ns; // "baseline" runs first
+            $overhead = round($ns - $baseline, 2);
+
+            if ($format === 'json') {
+                echo json_encode([
+                    'config' => $config,
+                    'jit' => $jit,
+                    'workload' => $workload,
+                    'ns_per_call' => $ns,
+                    'overhead_ns' => $overhead,
+                    'iterations' => $workloadIterations,
+                ]), "\n";
+            } else {
+                printf("%-40s %-12s %-5s %12.2f %+12.2f\n", $workload, $config, $jit ? 'yes' : 'no', $ns, $overhead);
+            }
+        }
+    }
+}
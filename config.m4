@@ -41,4 +41,15 @@ if test "$PHP_RAYAOP" != "no"; then
   if test "$PHP_RAYAOP_QUIET" != "no"; then
       AC_DEFINE(RAYAOP_QUIET, 1, [Whether to suppress experimental notices])
   fi
+
+  dnl USDT probes for bpftrace, perf and SystemTap (requires sys/sdt.h, e.g. from systemtap-sdt-dev)
+  dnl link https://sourceware.org/systemtap/wiki/UserSpaceProbeImplementation
+  PHP_ARG_ENABLE(rayaop-dtrace, whether to enable rayaop USDT probes,
+  [ --enable-rayaop-dtrace   Enable USDT probes at interception entry and exit], no, no)
+
+  if test "$PHP_RAYAOP_DTRACE" != "no"; then
+      AC_CHECK_HEADER([sys/sdt.h],
+        [AC_DEFINE(HAVE_RAYAOP_DTRACE, 1, [Whether USDT probes are enabled])],
+        [AC_MSG_ERROR([Cannot find sys/sdt.h which is required for --enable-rayaop-dtrace])])
+  fi
 fi
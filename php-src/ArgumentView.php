@@ -0,0 +1,47 @@
+<?php
+
+namespace Ray\Aop;
+
+/**
+ * Argument View
+ *
+ * Read-only view of the arguments of an intercepted call, returned by
+ * NativeMethodInvocation::getArgumentView(). Arguments are read from the call frame on access;
+ * nothing is copied until toArray() is called. It is only valid while the invocation runs.
+ *
+ * @implements \ArrayAccess<int|string, mixed>
+ */
+final class ArgumentView implements \ArrayAccess, \Countable
+{
+    /**
+     * Check whether an argument was passed (by position or parameter name)
+     */
+    public function offsetExists(mixed $offset): bool {}
+
+    /**
+     * Read an argument (by position or parameter name), null if it was not passed
+     */
+    public function offsetGet(mixed $offset): mixed {}
+
+    /**
+     * Always throws: the view is read-only
+     */
+    public function offsetSet(mixed $offset, mixed $value): void {}
+
+    /**
+     * Always throws: the view is read-only
+     */
+    public function offsetUnset(mixed $offset): void {}
+
+    /**
+     * Count the passed arguments (positional and collected named arguments)
+     */
+    public function count(): int {}
+
+    /**
+     * Copy the arguments into an array (same as NativeMethodInvocation::getArguments())
+     *
+     * @return array<mixed>
+     */
+    public function toArray(): array {}
+}
@@ -12,7 +12,9 @@ interface MethodInterceptorInterface
     /**
      * Intercept method
      *
-     * This method is called when an intercepted method is invoked.
+     * This method is called when an intercepted method is invoked. For a static method the
+     * extension passes the name of the called class instead of an object, and for a function null;
+     * implementations widen $object to object|string|null to intercept them.
      *
      * @param object       $object The object on which the method was called
      * @param string       $method The name of the method being called
@@ -0,0 +1,23 @@
+<?php
+
+namespace Ray\Aop;
+
+/**
+ * Native Method Interceptor Interface
+ *
+ * Interceptors implementing this interface receive the intercepted call as a NativeMethodInvocation
+ * and reach the original method through proceed() instead of calling it again by name.
+ */
+interface NativeMethodInterceptorInterface
+{
+    /**
+     * Invoke method
+     *
+     * This method is called when an intercepted method is invoked.
+     *
+     * @param NativeMethodInvocation $invocation The intercepted call
+     *
+     * @return mixed The result of the method invocation
+     */
+    public function invoke(NativeMethodInvocation $invocation): mixed;
+}
@@ -0,0 +1,46 @@
+<?php
+
+namespace Ray\Aop;
+
+/**
+ * Native Method Invocation
+ *
+ * Created by the extension for each call of a NativeMethodInterceptorInterface. It is only valid
+ * while the interceptor's invoke() method runs.
+ */
+final class NativeMethodInvocation
+{
+    /**
+     * Execute the original method with the intercepted arguments
+     *
+     * @return mixed The result of the original method
+     */
+    public function proceed(): mixed {}
+
+    /**
+     * Get the object on which the method was called (null for a static method or a function)
+     */
+    public function getThis(): ?object {}
+
+    /**
+     * Get the class on which the method was called (static:: for a static method, null for a function)
+     */
+    public function getClassName(): ?string {}
+
+    /**
+     * Get the name of the intercepted method
+     */
+    public function getMethodName(): string {}
+
+    /**
+     * Get the arguments of the intercepted call
+     *
+     * @return array<mixed>
+     */
+    public function getArguments(): array {}
+
+    /**
+     * Get a read-only view of the arguments that reads the call frame on access (no copy)
+     */
+    public function getArgumentView(): ArgumentView {}
+}
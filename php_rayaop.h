@@ -12,6 +12,14 @@
 #include "ext/standard/info.h"  /* Include standard extension module information related header */
 #include "zend_exceptions.h"  /* Include Zend exception handling related header */
 #include "zend_interfaces.h"  /* Include Zend interface related header */
+#include "zend_extensions.h"  /* Include Zend extension related header (op_array extension handles) */
+#include "zend_observer.h"  /* Include Zend observer API header */
+#include "zend_closures.h"  /* Include Zend closure related header */
+#include "zend_vm.h"  /* Include Zend VM related header (opcode handlers) */
+#include "zend_fibers.h"  /* Include Zend fiber header (per-fiber invocation stacks) */
+#include "ext/standard/hrtime.h"  /* Include high resolution timer header (rayaop.stats) */
+#include "zend_smart_str.h"  /* Include smart string header (method_memoize() keys) */
+#include "zend_arena.h"  /* Include Zend arena header (binding storage) */
 
 /* If in thread-safe mode, then include Thread Safe Resource Manager */
 #ifdef ZTS
@@ -50,13 +58,148 @@ extern zend_module_entry rayaop_module_entry;
 #define PHP_RAYAOP_DEBUG_PRINT(fmt, ...)  /* Do nothing */
 #endif
 
-/* Structure to hold intercept information */
+/* Interception backends (rayaop.backend INI setting) */
+#define PHP_RAYAOP_BACKEND_EXECUTE_EX 0 /* Replace zend_execute_ex (default) */
+#define PHP_RAYAOP_BACKEND_OBSERVER 1 /* Observer API begin handlers on intercepted functions only */
+
+/* Interceptor chain operations (method_intercept*() functions) */
+#define PHP_RAYAOP_CHAIN_REPLACE 0 /* Replace the chain with a single interceptor */
+#define PHP_RAYAOP_CHAIN_APPEND 1 /* Add an interceptor at the end (innermost) */
+#define PHP_RAYAOP_CHAIN_PREPEND 2 /* Add an interceptor at the start (outermost) */
+#define PHP_RAYAOP_CHAIN_REMOVE 3 /* Remove an interceptor */
+
+#define PHP_RAYAOP_ARENA_SIZE (8 * 1024) /* Size of the chunks of the binding arena */
+#define PHP_RAYAOP_ARENA_EXACT_HANDLERS 4 /* Chains up to this length get a size class of their own, longer ones are rounded up to a power of two */
+#define PHP_RAYAOP_ARENA_CLASSES (PHP_RAYAOP_ARENA_EXACT_HANDLERS + 30) /* Size classes of the binding arena (lengths 1 to 4, then 8 to 2^32) */
+#define PHP_RAYAOP_KEY_SIZE 256 /* Intercept keys up to this length are built on the stack */
+
+/* Release an intercept key built by php_rayaop_build_intercept_key() into the stack buffer buf */
+#define PHP_RAYAOP_RELEASE_KEY(key, buf) do { if ((key) != (buf)) { efree(key); } } while (0)
+
+/* Registry images (rayaop_registry_export(), rayaop.registry_file) */
+#define PHP_RAYAOP_REGISTRY_MAGIC "RAYAOPRG" /* First bytes of an image */
+#define PHP_RAYAOP_REGISTRY_VERSION 1 /* Format version (written in the byte order of the machine, so images of other byte orders are rejected) */
+
+struct _php_rayaop_invocation;
+
+/* Native advice callbacks (php_rayaop_register_advice()) */
+typedef void (*php_rayaop_before_advice_t)(zend_execute_data *execute_data, void *user_data); /* Receives the intercepted frame before the call proceeds */
+typedef void (*php_rayaop_around_advice_t)(struct _php_rayaop_invocation *invocation, zval *retval, void *user_data); /* Proceeds itself with php_rayaop_proceed() */
+typedef void (*php_rayaop_after_advice_t)(zend_execute_data *execute_data, zval *retval, void *user_data); /* Receives the result (UNDEF if an exception is pending) */
+
+/* Structure to hold native advice registered by another extension (every callback may be NULL) */
+typedef struct _php_rayaop_advice {
+    php_rayaop_before_advice_t before; /* Called first; an exception thrown here skips the call */
+    php_rayaop_around_advice_t around; /* Called in place of proceeding to the next interceptor or the original method */
+    php_rayaop_after_advice_t after; /* Called last, also when an exception is pending */
+} php_rayaop_advice;
+
+/* Structure to hold one interceptor of a chain */
+typedef struct _php_rayaop_handler {
+    zval object; /* Intercept handler (UNDEF for native advice) */
+    zend_fcall_info_cache fcc; /* intercept() or invoke() method of the handler, resolved at registration time */
+    bool native; /* Whether the handler proceeds explicitly (NativeMethodInterceptorInterface or native advice) */
+    const php_rayaop_advice *advice; /* Native advice, NULL for interceptor objects */
+    void *advice_data; /* User pointer passed to the advice callbacks */
+} php_rayaop_handler;
+
+/* Structure to hold the result cache of a method_memoize() binding (request memory) */
+typedef struct _php_rayaop_memo {
+    HashTable results; /* Results by receiver and argument key, least recently used first */
+    HashTable receivers; /* Objects of the cached results by the same key (a reference keeps their handles from being reused) */
+    zend_long max_entries; /* Number of results kept before the least recently used one is evicted */
+} php_rayaop_memo;
+
+/* Structure to hold the call statistics of a binding (persistent memory, rayaop.stats) */
+typedef struct _php_rayaop_binding_stats {
+    zend_ulong calls; /* Number of intercepted calls */
+    uint64_t total_ns; /* Cumulative wall time of the intercepted calls */
+    uint64_t max_ns; /* Longest intercepted call */
+    uint64_t original_ns; /* Cumulative wall time spent in the original method */
+    uint64_t max_original_ns; /* Longest time spent in the original method by one call */
+} php_rayaop_binding_stats;
+
+/* Structure to hold intercept information (the chain is immutable once registered and replaced when it changes) */
 typedef struct _php_rayaop_intercept_info {
     zend_string *class_name; /* Class name to intercept */
     zend_string *method_name; /* Method name to intercept */
-    zval handler; /* Intercept handler */
+    uint32_t refcount; /* References held by the registry and by active invocations */
+    uint32_t handler_count; /* Number of interceptors in the chain */
+    uint32_t sample_rate; /* One in sample_rate outermost calls is intercepted (1: every call; carried over to new chains) */
+    php_rayaop_binding_stats *stats; /* Statistics of the binding, resolved on the first recorded call */
+    php_rayaop_handler handlers[1]; /* Interceptor chain in execution order (allocated inline) */
 } php_rayaop_intercept_info;
 
+/* Structure to hold the interceptors bound to one method of one object (method_intercept_object()) */
+typedef struct _php_rayaop_instance_binding {
+    php_rayaop_intercept_info *own; /* Interceptors bound to the object */
+    php_rayaop_intercept_info *combined; /* own followed by the class-level chain, built on the next call (NULL until then) */
+    php_rayaop_intercept_info *base; /* Class-level chain combined was built from (a reference is held, NULL if none) */
+    zend_string *key; /* Intercept key ("class::method") counted in instance_methods */
+} php_rayaop_instance_binding;
+
+/* Structure to hold an active invocation (lives on the C stack while the handler runs) */
+typedef struct _php_rayaop_invocation {
+    zend_execute_data *execute_data; /* The intercepted frame (initialized, not executed) */
+    php_rayaop_intercept_info *info; /* The intercept information (a reference is held) */
+    uint32_t index; /* Position of the running interceptor in the chain */
+    zend_execute_data *proceed_frame; /* Frame executing the original method, NULL outside proceed */
+    bool reentered; /* Whether proceed_frame was entered by a call by name (observer backend, cleared by the end handler) */
+    zval argument_view; /* Ray\Aop\ArgumentView created on demand (UNDEF until requested) */
+    uint64_t original_ns; /* Time spent in the original method (rayaop.stats) */
+    php_hrtime_t original_start; /* Start of the running original method (rayaop.stats) */
+    struct _php_rayaop_invocation *prev; /* Enclosing invocation */
+} php_rayaop_invocation;
+
+/* Structure of a Ray\Aop\NativeMethodInvocation or Ray\Aop\ArgumentView object */
+typedef struct _php_rayaop_invocation_object {
+    php_rayaop_invocation *invocation; /* The invocation, NULL once the handler has returned */
+    zend_object std; /* Standard object */
+} php_rayaop_invocation_object;
+
+/* Structure to hold a matcher turned into bindings when a class is first used */
+typedef struct _php_rayaop_matcher {
+    zend_string *class_pattern; /* Glob pattern for the declaring class */
+    zend_string *method_pattern; /* Glob pattern for the method name */
+    zend_string *attribute; /* Lowercase name of the required attribute, NULL for none */
+    zval handler; /* Intercept handler appended to matching methods */
+} php_rayaop_matcher;
+
+/* Structure to hold a binding registered for the lifetime of the process (persistent memory, immutable strings) */
+typedef struct _php_rayaop_persistent_info {
+    zend_string *key; /* Intercept key ("class::method") */
+    zend_string *class_name; /* Class name to intercept */
+    zend_string *method_name; /* Method name to intercept */
+    zend_string *handler_class; /* Interceptor class, instantiated lazily per request */
+    uint32_t refcount; /* Registries holding the binding (changed with the registry mutex held under ZTS) */
+} php_rayaop_persistent_info;
+
+/* Structure to hold the process-wide registry of persistent bindings (read-only once published under ZTS) */
+typedef struct _php_rayaop_registry {
+    HashTable bindings; /* Persistent bindings by intercept key */
+    HashTable classes; /* Names of classes with at least one persistent binding */
+    uint32_t readers; /* Requests attached to the registry (ZTS, changed with the registry mutex held) */
+    struct _php_rayaop_registry *retired; /* Next replaced registry still read by a request (ZTS, freed when its last reader detaches) */
+} php_rayaop_registry;
+
+/* Header of a registry image, followed by count records of three uint32_t lengths (class, method,
+   interceptor class) and the three names, each terminated by a NUL byte */
+typedef struct _php_rayaop_registry_header {
+    char magic[8]; /* PHP_RAYAOP_REGISTRY_MAGIC */
+    uint32_t version; /* PHP_RAYAOP_REGISTRY_VERSION */
+    uint32_t count; /* Number of bindings */
+    uint32_t size; /* Size of the image including this header */
+    uint32_t reserved; /* Zero */
+} php_rayaop_registry_header;
+
+/* Ray\Aop\MethodInterceptorInterface class entry */
+extern zend_class_entry *ray_aop_method_interceptor_interface_ce;
+
+/* Ray\Aop\NativeMethodInterceptorInterface and Ray\Aop\NativeMethodInvocation class entries */
+extern zend_class_entry *ray_aop_native_method_interceptor_interface_ce;
+extern zend_class_entry *ray_aop_native_method_invocation_ce;
+extern zend_class_entry *ray_aop_argument_view_ce; /* Ray\Aop\ArgumentView class entry */
+
 /* Function declarations */
 PHP_MINIT_FUNCTION(rayaop); /* Module initialization function */
 PHP_MSHUTDOWN_FUNCTION(rayaop); /* Module shutdown function */
@@ -64,13 +207,55 @@ PHP_RINIT_FUNCTION(rayaop); /* Request initialization function */
 PHP_RSHUTDOWN_FUNCTION(rayaop); /* Request shutdown function */
 PHP_MINFO_FUNCTION(rayaop); /* Module information function */
 PHP_FUNCTION(method_intercept); /* Method intercept function */
+PHP_FUNCTION(method_intercept_append); /* Append to interceptor chain function */
+PHP_FUNCTION(method_intercept_prepend); /* Prepend to interceptor chain function */
+PHP_FUNCTION(method_intercept_remove); /* Remove from interceptor chain function */
+PHP_FUNCTION(method_intercept_many); /* Batch method intercept function */
+PHP_FUNCTION(method_intercept_match); /* Pattern method intercept function */
+PHP_FUNCTION(method_intercept_persistent); /* Persistent method intercept function */
+PHP_FUNCTION(rayaop_registry_export); /* Registry image export function */
+PHP_FUNCTION(method_memoize); /* Memoizing binding function */
+PHP_FUNCTION(method_intercept_sample); /* Sampling rate function */
+PHP_FUNCTION(function_intercept); /* Function intercept function */
+PHP_FUNCTION(method_intercept_object); /* Per-object method intercept function */
+PHP_FUNCTION(method_intercept_object_remove); /* Per-object interceptor removal function */
+PHP_FUNCTION(rayaop_stats); /* Statistics function */
+PHP_FUNCTION(rayaop_enable); /* Global enable function */
+PHP_FUNCTION(rayaop_disable); /* Global disable function */
 
 /* Utility function declarations */
 void php_rayaop_handle_error(const char *message); /* Error handling function */
 bool php_rayaop_should_intercept(zend_execute_data *execute_data); /* Function to determine if interception is necessary */
-char *php_rayaop_generate_intercept_key(zend_string *class_name, zend_string *method_name, size_t *key_len); /* Function to generate intercept key */
+char *php_rayaop_build_intercept_key(char *buf, const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, size_t *key_len); /* Function to build intercept key */
 php_rayaop_intercept_info *php_rayaop_find_intercept_info(const char *key, size_t key_len); /* Function to search for intercept information */
-void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info); /* Function to execute interception */
+void php_rayaop_mark_class(const char *class_name, size_t class_name_len); /* Function to mark a class as having interceptors */
+void php_rayaop_unmark_class(const char *class_name, size_t class_name_len); /* Function to drop the mark of a class for one method */
+bool php_rayaop_class_has_interceptors(zend_class_entry *ce); /* Function to determine if any method of a class is intercepted */
+bool php_rayaop_glob_match(const char *pattern, size_t pattern_len, const char *subject, size_t subject_len); /* Function to match a name against a glob pattern */
+void php_rayaop_apply_matchers(zend_class_entry *ce); /* Function to evaluate all matchers against a class */
+php_rayaop_intercept_info *php_rayaop_resolve_intercept_info(zend_function *func); /* Function to resolve intercept information through the registry */
+php_rayaop_intercept_info *php_rayaop_lookup_internal_intercept_info(zend_execute_data *execute_data); /* Function to look up intercept information of an internal function or method */
+php_rayaop_intercept_info *php_rayaop_lookup_intercept_info(zend_execute_data *execute_data); /* Function to look up intercept information through the per-function cache */
+php_rayaop_intercept_info *php_rayaop_instance_intercept_info(zend_execute_data *execute_data, php_rayaop_intercept_info *info); /* Function to add the interceptors bound to the called object */
+bool php_rayaop_prepare_handler_fcc(zval *handler, zend_fcall_info_cache *fcc); /* Function to resolve the method of an interceptor */
+PHP_RAYAOP_API zval *php_rayaop_frame_arg(zend_execute_data *execute_data, uint32_t n); /* Function to get an argument of a frame */
+void php_rayaop_copy_frame_args(zend_execute_data *execute_data, zval *args); /* Function to copy the arguments of a frame into an array */
+php_rayaop_invocation *php_rayaop_find_reentry(zend_execute_data *execute_data); /* Function to detect a classic interceptor calling its intercepted method */
+PHP_RAYAOP_API void php_rayaop_proceed(php_rayaop_invocation *invocation, zval *retval); /* Function to execute the original method of an invocation */
+void php_rayaop_invocation_object_init(zval *object, php_rayaop_invocation *invocation); /* Function to create a Ray\Aop\NativeMethodInvocation */
+void php_rayaop_invocation_object_detach(zval *object); /* Function to detach a Ray\Aop\NativeMethodInvocation from its invocation */
+bool php_rayaop_call_interceptor(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index, zval *retval); /* Function to call the intercept handler in place of the original method */
+void php_rayaop_release_frame(zend_execute_data *execute_data); /* Function to release a frame that was intercepted instead of executed */
+bool php_rayaop_register_intercept(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, zval *handler, int mode); /* Function to register intercept information in the request registry */
+PHP_RAYAOP_API bool php_rayaop_register_advice(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const php_rayaop_advice *advice, void *user_data, int mode); /* Function to register native advice of another extension */
+void php_rayaop_update_hooks(void); /* Function to install or remove the execution hooks (rayaop.lazy) */
+void php_rayaop_registry_changed(void); /* Function to invalidate cached lookups after a change of the request registry */
+void php_rayaop_batch_begin(void); /* Function to start a batch of registry changes */
+void php_rayaop_batch_end(bool invalidate); /* Function to end a batch of registry changes */
+php_rayaop_intercept_info *php_rayaop_materialize_persistent_info(const char *key, size_t key_len); /* Function to turn a persistent binding into intercept information of the current request */
+void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index); /* Function to execute interception */
+php_rayaop_intercept_info *php_rayaop_alloc_intercept_info(zend_string *class_name, zend_string *method_name, uint32_t handler_count); /* Function to allocate intercept information */
+void php_rayaop_release_intercept_info(php_rayaop_intercept_info *info); /* Function to release a reference to intercept information */
 void php_rayaop_free_intercept_info(zval *zv); /* Function to free intercept information */
 
 #ifdef RAYAOP_DEBUG  /* If debug mode is enabled */
@@ -81,7 +266,37 @@ static void php_rayaop_dump_intercept_info(void);  /* Function to dump intercept
 ZEND_BEGIN_MODULE_GLOBALS(rayaop)
     /* Start of rayaop module global variables */
     HashTable *intercept_ht; /* Intercept hash table */
-    zend_bool is_intercepting; /* Intercepting flag */
+    HashTable *persistent_ht; /* Persistent bindings of the process-wide registry seen by the current request (borrowed) */
+    HashTable *persistent_classes; /* Names of classes with at least one persistent binding (borrowed from the same registry) */
+    php_rayaop_registry *registry; /* Published registry the current request is attached to (ZTS) */
+    php_rayaop_registry *registry_draft; /* Private copy with the persistent bindings of the current request, published at its end (ZTS) */
+    HashTable *persistent_handlers; /* Interceptor instances of persistent bindings for the current request */
+    HashTable *intercept_classes; /* Names of classes with at least one binding (name => number of bindings) */
+    HashTable *matchers; /* Matchers in registration order (method_intercept_match) */
+    HashTable *matched_classes; /* Names of classes the matchers were evaluated against */
+    php_rayaop_invocation *invocation; /* Innermost active invocation of the running fiber (swapped on fiber switches) */
+    zend_execute_data *pending_return; /* Frame waiting to be redirected to the synthetic return (observer backend) */
+    char *backend; /* Interception backend (rayaop.backend) */
+    char *bindings; /* Persistent bindings loaded at startup (rayaop.bindings) */
+    char *registry_file; /* Registry image loaded at startup (rayaop.registry_file) */
+    zend_bool intercept_internal; /* Whether internal methods are intercepted (rayaop.intercept_internal) */
+    HashTable *internal_cache; /* Lookup results of internal functions for the current request (zend_function* => info) */
+    uintptr_t internal_cache_generation; /* Registry generation of internal_cache */
+    uintptr_t generation; /* Registry generation, bumped whenever cached lookups become stale */
+    uint32_t batch_depth; /* Nesting depth of registry batches (php_rayaop_batch_begin()) */
+    zend_bool batch_changed; /* Whether the registry changed inside the current batch */
+    zend_bool stats; /* Whether call statistics are collected (rayaop.stats) */
+    HashTable *stats_ht; /* Statistics by "class::method" (survives requests) */
+    zend_ulong stats_rejected; /* Calls rejected on the fast path while collecting statistics */
+    zend_bool lazy; /* Whether the execution hooks are only installed while bindings exist (rayaop.lazy) */
+    zend_bool enabled; /* Global switch of the current request (rayaop_enable() / rayaop_disable()) */
+    HashTable *memos; /* Result caches of method_memoize() bindings for the current request */
+    zend_arena *arena; /* Storage of the chains of the current request (created on the first binding) */
+    php_rayaop_intercept_info *free_infos[PHP_RAYAOP_ARENA_CLASSES]; /* Released arena chains by size class, reused before the arena grows */
+    uint64_t sample_state; /* State of the sampling random number generator (xorshift64*) */
+    uint32_t intercept_size_hint; /* Number of bindings of the previous request, used to size the registry */
+    zval instances; /* WeakMap of objects with their own interceptors (object => bindings resource, UNDEF until the first one) */
+    HashTable *instance_methods; /* Intercept keys of methods bound on at least one object (key => number of objects) */
 ZEND_END_MODULE_GLOBALS(rayaop) /* End of rayaop module global variables */
 
 /* If in thread-safe mode, global variable access macro (thread-safe version) */
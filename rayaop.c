@@ -10,314 +10,4053 @@
 
 // #define RAYAOP_DEBUG
 
+/* USDT probes (--enable-rayaop-dtrace); sys/sdt.h must see this before php.h includes it */
+#ifdef HAVE_RAYAOP_DTRACE
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#endif
+
 #include "php_rayaop.h"  /* Include header file for RayAOP extension */
 
 /* Declaration of module global variables */
 ZEND_DECLARE_MODULE_GLOBALS(rayaop)
 
+/* USDT probe semaphores: non-zero while a tracer (bpftrace, perf, SystemTap) is attached to the probe,
+   so the arguments of a probe are only prepared while somebody listens */
+#ifdef HAVE_RAYAOP_DTRACE
+__extension__ unsigned short rayaop_intercept__entry_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+__extension__ unsigned short rayaop_intercept__return_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+__extension__ unsigned short rayaop_intercept__rejected_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+#define PHP_RAYAOP_PROBE_ENABLED(name) __builtin_expect(rayaop_##name##_semaphore, 0)
+#define PHP_RAYAOP_PROBE(name, ...) STAP_PROBEV(rayaop, name, __VA_ARGS__)
+#else
+#define PHP_RAYAOP_PROBE_ENABLED(name) 0
+#define PHP_RAYAOP_PROBE(name, ...)
+#endif
+
 /* Declaration of static variable: pointer to the original zend_execute_ex function */
 static void (*php_rayaop_original_execute_ex)(zend_execute_data *execute_data);
 
+/* Declaration of static variable: pointer to the original zend_execute_internal function (rayaop.intercept_internal, may be NULL) */
+static void (*php_rayaop_original_execute_internal)(zend_execute_data *execute_data, zval *return_value);
+
+#ifndef ZTS
+/* Declaration of static variables: pointers to the original compiler functions (rayaop.lazy) */
+static zend_op_array *(*php_rayaop_original_compile_file)(zend_file_handle *file_handle, int type);
+#if PHP_VERSION_ID >= 80200
+static zend_op_array *(*php_rayaop_original_compile_string)(zend_string *source_string, const char *filename, zend_compile_position position);
+#else
+static zend_op_array *(*php_rayaop_original_compile_string)(zend_string *source_string, const char *filename);
+#endif
+#endif
+
+/* Declaration of static variable: pointer to the original zend_interrupt_function (observer backend) */
+static void (*php_rayaop_original_interrupt_function)(zend_execute_data *execute_data);
+
+/* Synthetic "return null" opline that leaves a frame handled by the observer backend */
+static struct {
+    zend_op op; /* ZEND_RETURN with a constant operand */
+    zval value; /* The constant operand (addressed relative to the opline) */
+} php_rayaop_return_op;
+
+/* Selected interception backend */
+static int php_rayaop_backend = PHP_RAYAOP_BACKEND_EXECUTE_EX;
+
+/* Process-wide registry of persistent bindings, published with an atomic pointer store */
+static php_rayaop_registry *php_rayaop_registry_current = NULL;
+
+/* Names used by persistent bindings, each allocated once and shared by all registries (freed at module shutdown) */
+static HashTable *php_rayaop_registry_strings = NULL;
+
+#ifdef ZTS
+/* Serializes registry writers, and readers attaching to or detaching from a registry */
+static MUTEX_T php_rayaop_registry_mutex;
+
+/* Replaced registries still read by a request, linked through their retired field */
+static php_rayaop_registry *php_rayaop_registry_retired = NULL;
+#endif
+
+/* Atomic access to the published registry */
+#ifdef PHP_WIN32
+#define PHP_RAYAOP_ATOMIC_LOAD_PTR(ptr) InterlockedCompareExchangePointer((PVOID volatile *) (ptr), NULL, NULL)
+#define PHP_RAYAOP_ATOMIC_STORE_PTR(ptr, value) InterlockedExchangePointer((PVOID volatile *) (ptr), (value))
+#else
+#define PHP_RAYAOP_ATOMIC_LOAD_PTR(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define PHP_RAYAOP_ATOMIC_STORE_PTR(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#endif
+
+/* Slot in zend_fiber_context.reserved holding the invocation stack of a suspended fiber */
+static int php_rayaop_fiber_handle = -1;
+
+/* Whether the execution hooks are currently installed (always true unless rayaop.lazy removed them) */
+static bool php_rayaop_hooks_installed = false;
+
+/* Run-time cache slots reserved on every op_array for the cached intercept binding */
+static int php_rayaop_cache_generation_handle = -1; /* Slot holding the registry generation of the cached lookup */
+static int php_rayaop_cache_info_handle = -1; /* Slot holding the cached intercept information (NULL if not intercepted) */
+static int php_rayaop_cache_observed_handle = -1; /* Slot marking functions the observer handlers are attached to (observer backend) */
+
+/* Low bit of a resolved lookup: objects may have their own interceptors for the method (chains are at least 8-byte aligned) */
+#define PHP_RAYAOP_INSTANCE_TAG ((uintptr_t) 1)
+
+/* WeakMap class entry (not exported by the engine, looked up at startup) */
+static zend_class_entry *php_rayaop_weakmap_ce = NULL;
+
+/* Resource type of the per-object binding tables stored in the WeakMap */
+static int php_rayaop_le_instance_bindings = -1;
+
 /* {{{ proto void php_rayaop_init_globals(zend_rayaop_globals *rayaop_globals)
    Global initialization function
 
-   This function initializes the global variables for the RayAOP extension.
+   This function initializes the global variables for the RayAOP extension.
+
+   @param zend_rayaop_globals *rayaop_globals Pointer to global variables
+*/
+static void php_rayaop_init_globals(zend_rayaop_globals *rayaop_globals) {
+    rayaop_globals->intercept_ht = NULL; /* Initialize intercept hash table */
+    rayaop_globals->intercept_classes = NULL; /* Initialize intercepted class table */
+    rayaop_globals->persistent_ht = NULL; /* Initialize persistent intercept hash table */
+    rayaop_globals->persistent_classes = NULL; /* Initialize persistent intercepted class table */
+    rayaop_globals->registry = NULL; /* Initialize attached registry */
+    rayaop_globals->registry_draft = NULL; /* Initialize unpublished registry */
+    rayaop_globals->persistent_handlers = NULL; /* Initialize request cache of persistent interceptors */
+    rayaop_globals->matchers = NULL; /* Initialize matcher list */
+    rayaop_globals->matched_classes = NULL; /* Initialize matched class table */
+    rayaop_globals->invocation = NULL; /* Initialize active invocation stack */
+    rayaop_globals->pending_return = NULL; /* Initialize pending observer redirection */
+    rayaop_globals->backend = NULL; /* Initialize backend INI value */
+    rayaop_globals->bindings = NULL; /* Initialize startup bindings INI value */
+    rayaop_globals->registry_file = NULL; /* Initialize registry image INI value */
+    rayaop_globals->intercept_internal = 0; /* Initialize internal interception INI value */
+    rayaop_globals->internal_cache = NULL; /* Initialize internal function lookup cache */
+    rayaop_globals->internal_cache_generation = 0; /* Initialize internal function lookup cache generation */
+    rayaop_globals->stats = 0; /* Initialize statistics INI value */
+    rayaop_globals->stats_ht = NULL; /* Initialize statistics table */
+    rayaop_globals->stats_rejected = 0; /* Initialize rejected call counter */
+    rayaop_globals->generation = 1; /* Initialize registry generation (0 marks an empty cache slot) */
+    rayaop_globals->batch_depth = 0; /* Initialize registry batch depth */
+    rayaop_globals->batch_changed = 0; /* Initialize registry batch change flag */
+    rayaop_globals->lazy = 0; /* Initialize lazy hook INI value */
+    rayaop_globals->enabled = 1; /* Initialize global switch */
+    rayaop_globals->memos = NULL; /* Initialize memoization result caches */
+    rayaop_globals->arena = NULL; /* Initialize binding arena */
+    memset(rayaop_globals->free_infos, 0, sizeof(rayaop_globals->free_infos)); /* Initialize released chain lists */
+    rayaop_globals->intercept_size_hint = 8; /* Initialize registry size hint */
+    rayaop_globals->sample_state = (uint64_t) php_hrtime_current() ^ (uint64_t) (uintptr_t) rayaop_globals; /* Seed the sampling generator per thread */
+    rayaop_globals->sample_state |= 1; /* The generator state must not be zero */
+    ZVAL_UNDEF(&rayaop_globals->instances); /* Initialize per-object bindings */
+    rayaop_globals->instance_methods = NULL; /* Initialize table of methods bound on objects */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_shutdown_globals(zend_rayaop_globals *rayaop_globals)
+   Global shutdown function
+
+   This function frees the statistics of a process (or thread). The persistent registry is
+   shared by all threads and freed at module shutdown.
+
+   @param zend_rayaop_globals *rayaop_globals Pointer to global variables
+*/
+static void php_rayaop_shutdown_globals(zend_rayaop_globals *rayaop_globals) {
+    rayaop_globals->persistent_ht = NULL; /* Borrowed from the process-wide registry */
+    rayaop_globals->persistent_classes = NULL;
+    if (rayaop_globals->stats_ht) {
+        /* If statistics table exists */
+        zend_hash_destroy(rayaop_globals->stats_ht); /* Destroy hash table */
+        pefree(rayaop_globals->stats_ht, 1); /* Free memory for hash table */
+        rayaop_globals->stats_ht = NULL; /* Set hash table pointer to NULL */
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_free_stats(zval *zv)
+   Function to free the statistics of a binding
+
+   @param zval *zv The zval containing the statistics to be freed
+*/
+static void php_rayaop_free_stats(zval *zv) {
+    pefree(Z_PTR_P(zv), 1); /* Free memory for statistics */
+}
+/* }}} */
+
+/* Macro for debug output */
+#ifdef RAYAOP_DEBUG
+#define PHP_RAYAOP_DEBUG_PRINT(fmt, ...) php_printf("RAYAOP DEBUG: " fmt "\n", ##__VA_ARGS__)  /* Output debug information */
+#else
+#define PHP_RAYAOP_DEBUG_PRINT(fmt, ...)  /* Do nothing if not in debug mode */
+#endif
+
+/* INI entries */
+PHP_INI_BEGIN()
+    STD_PHP_INI_ENTRY("rayaop.backend", "execute_ex", PHP_INI_SYSTEM, OnUpdateString, backend, zend_rayaop_globals, rayaop_globals) /* Interception backend: execute_ex or observer */
+    STD_PHP_INI_ENTRY("rayaop.bindings", "", PHP_INI_SYSTEM, OnUpdateString, bindings, zend_rayaop_globals, rayaop_globals) /* Persistent bindings loaded at startup ("Class::method=Interceptor, ...") */
+    STD_PHP_INI_ENTRY("rayaop.registry_file", "", PHP_INI_SYSTEM, OnUpdateString, registry_file, zend_rayaop_globals, rayaop_globals) /* Registry image loaded at startup (rayaop_registry_export()) */
+    STD_PHP_INI_BOOLEAN("rayaop.stats", "0", PHP_INI_ALL, OnUpdateBool, stats, zend_rayaop_globals, rayaop_globals) /* Collect per-binding call statistics */
+    STD_PHP_INI_BOOLEAN("rayaop.intercept_internal", "0", PHP_INI_SYSTEM, OnUpdateBool, intercept_internal, zend_rayaop_globals, rayaop_globals) /* Hook zend_execute_internal to intercept internal methods */
+    STD_PHP_INI_BOOLEAN("rayaop.lazy", "0", PHP_INI_SYSTEM, OnUpdateBool, lazy, zend_rayaop_globals, rayaop_globals) /* Only install the execution hooks while bindings exist */
+PHP_INI_END()
+
+/* Argument information for method_intercept function */
+ZEND_BEGIN_ARG_INFO_EX(arginfo_method_intercept, 0, 0, 3)
+    ZEND_ARG_TYPE_INFO(0, class_name, IS_STRING, 0) /* Argument information for class name */
+    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
+    ZEND_ARG_TYPE_INFO(0, interceptor, IS_OBJECT, 0) /* Argument information for intercept handler (classic or native interceptor) */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_intercept_many function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_intercept_many, 0, 1, IS_LONG, 0)
+    ZEND_ARG_TYPE_INFO(0, bindings, IS_ARRAY, 0) /* Argument information for [class name, method name, interceptor] lists */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_intercept_sample function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_intercept_sample, 0, 3, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, class_name, IS_STRING, 0) /* Argument information for class name */
+    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
+    ZEND_ARG_TYPE_INFO(0, rate, IS_LONG, 0) /* Argument information for sampling rate (one in rate calls) */
+ZEND_END_ARG_INFO()
+
+/* Argument information for function_intercept function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_function_intercept, 0, 2, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, function_name, IS_STRING, 0) /* Argument information for function name */
+    ZEND_ARG_TYPE_INFO(0, interceptor, IS_OBJECT, 0) /* Argument information for intercept handler */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_intercept_object and method_intercept_object_remove functions */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_intercept_object, 0, 3, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, object, IS_OBJECT, 0) /* Argument information for the bound object */
+    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
+    ZEND_ARG_TYPE_INFO(0, interceptor, IS_OBJECT, 0) /* Argument information for intercept handler */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_intercept_match function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_intercept_match, 0, 3, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, class_pattern, IS_STRING, 0) /* Argument information for class name pattern */
+    ZEND_ARG_TYPE_INFO(0, method_pattern, IS_STRING, 0) /* Argument information for method name pattern */
+    ZEND_ARG_TYPE_INFO(0, interceptor, IS_OBJECT, 0) /* Argument information for intercept handler */
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, attribute, IS_STRING, 1, "null") /* Argument information for required attribute */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_intercept_persistent function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_intercept_persistent, 0, 3, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, class_name, IS_STRING, 0) /* Argument information for class name */
+    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
+    ZEND_ARG_TYPE_INFO(0, interceptor_class, IS_STRING, 0) /* Argument information for interceptor class name */
+ZEND_END_ARG_INFO()
+
+/* Argument information for rayaop_registry_export function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_rayaop_registry_export, 0, 1, MAY_BE_LONG|MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, path, IS_STRING, 0) /* Argument information for the image path */
+ZEND_END_ARG_INFO()
+
+/* Argument information for method_memoize function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_method_memoize, 0, 2, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, class_name, IS_STRING, 0) /* Argument information for class name */
+    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, options, IS_ARRAY, 0, "[]") /* Argument information for options */
+ZEND_END_ARG_INFO()
+
+/* Argument information for rayaop_enable and rayaop_disable functions */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_rayaop_enable, 0, 0, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+/* Argument information for rayaop_stats function */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_rayaop_stats, 0, 0, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, reset, _IS_BOOL, 0, "false") /* Argument information for reset flag */
+ZEND_END_ARG_INFO()
+
+/* {{{ proto void php_rayaop_handle_error(const char *message)
+   Error handling function
+
+   This function handles errors by outputting an error message.
+
+   @param const char *message Error message to be displayed
+*/
+void php_rayaop_handle_error(const char *message) {
+    php_error_docref(NULL, E_ERROR, "Memory error: %s", message); /* Output error message */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_should_intercept(zend_execute_data *execute_data)
+   Function to determine if interception is necessary
+
+   This function checks if the current execution should be intercepted.
+
+   @param zend_execute_data *execute_data Execution data
+   @return bool Returns true if interception is necessary, false otherwise
+*/
+bool php_rayaop_should_intercept(zend_execute_data *execute_data) {
+    return RAYAOP_G(enabled) && /* Not switched off by rayaop_disable() */
+           execute_data->func->common.function_name && /* Function name exists (not a file or eval'd code) */
+           !(ZEND_CALL_INFO(execute_data) & ZEND_CALL_GENERATOR); /* Not a resumed generator */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_sample(php_rayaop_intercept_info *info)
+   Function to decide whether an outermost call of a sampled binding is intercepted
+
+   Calls are drawn at random (xorshift64* on per-thread state) rather than counted, so periodic
+   call patterns cannot always land on, or always miss, the intercepted call.
+
+   @param php_rayaop_intercept_info *info The intercept information
+   @return bool Returns true if the call is intercepted, false if it goes straight to the original method
+*/
+static zend_always_inline bool php_rayaop_sample(php_rayaop_intercept_info *info) {
+    if (EXPECTED(info->sample_rate == 1)) {
+        return true; /* Not sampled */
+    }
+
+    uint64_t x = RAYAOP_G(sample_state);
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    RAYAOP_G(sample_state) = x;
+    return (((x * UINT64_C(0x2545F4914F6CDD1D)) >> 32) * info->sample_rate) >> 32 == 0; /* Uniform in [0, sample_rate) without a division */
+}
+/* }}} */
+
+/* {{{ proto char* php_rayaop_build_intercept_key(char *buf, const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, size_t *key_len)
+   Function to build intercept key
+
+   This function creates a key in the format "class_name::method_name" for use in the intercept hash table.
+   Keys of up to PHP_RAYAOP_KEY_SIZE bytes are written to the caller's stack buffer, so that a lookup
+   does not allocate; the key is not NUL-terminated.
+
+   @param char *buf Buffer of PHP_RAYAOP_KEY_SIZE bytes
+   @param const char *class_name The name of the class (empty for functions)
+   @param size_t class_name_len The length of the class name
+   @param const char *method_name The name of the method
+   @param size_t method_name_len The length of the method name
+   @param size_t *key_len Pointer to store the length of the built key
+   @return char* The built key, which must be released by the caller using PHP_RAYAOP_RELEASE_KEY()
+*/
+char *php_rayaop_build_intercept_key(char *buf, const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, size_t *key_len) {
+    size_t len = class_name_len + 2 + method_name_len; /* Length of class_name::method_name */
+    char *key = EXPECTED(len <= PHP_RAYAOP_KEY_SIZE) ? buf : emalloc(len); /* Only unusually long names reach the heap */
+
+    memcpy(key, class_name, class_name_len);
+    key[class_name_len] = ':';
+    key[class_name_len + 1] = ':';
+    memcpy(key + class_name_len + 2, method_name, method_name_len);
+    *key_len = len;
+    return key;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_find_intercept_info(const char *key, size_t key_len)
+   Function to search for intercept information
+
+   This function searches for intercept information in the hash table using the provided key.
+
+   @param const char *key The key to search for
+   @param size_t key_len The length of the key
+   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_find_intercept_info(const char *key, size_t key_len) {
+    return zend_hash_str_find_ptr(RAYAOP_G(intercept_ht), key, key_len);
+    /* Search for intercept information in hash table */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_mark_class(const char *class_name, size_t class_name_len)
+   Function to mark a class as having interceptors
+
+   Classes are marked by name, so classes that are declared or autoloaded after the registration
+   are covered without any further work.
+
+   @param const char *class_name The name of the class
+   @param size_t class_name_len The length of the class name
+*/
+void php_rayaop_mark_class(const char *class_name, size_t class_name_len) {
+    zval *count = zend_hash_str_find(RAYAOP_G(intercept_classes), class_name, class_name_len); /* Search for existing mark */
+    if (count) {
+        Z_LVAL_P(count)++; /* One more intercepted method */
+    } else {
+        zval one;
+        ZVAL_LONG(&one, 1);
+        zend_hash_str_add_new(RAYAOP_G(intercept_classes), class_name, class_name_len, &one); /* First intercepted method */
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_unmark_class(const char *class_name, size_t class_name_len)
+   Function to drop the mark of a class when one of its methods loses its last interceptor
+
+   @param const char *class_name The name of the class
+   @param size_t class_name_len The length of the class name
+*/
+void php_rayaop_unmark_class(const char *class_name, size_t class_name_len) {
+    zval *count = zend_hash_str_find(RAYAOP_G(intercept_classes), class_name, class_name_len); /* Search for existing mark */
+    if (count && --Z_LVAL_P(count) == 0) {
+        zend_hash_str_del(RAYAOP_G(intercept_classes), class_name, class_name_len); /* No intercepted method left */
+    }
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_class_has_interceptors(zend_class_entry *ce)
+   Function to determine if any method of a class is intercepted
+
+   Class names are interned strings with a precomputed hash, so this is a single hash probe
+   without allocating or hashing a key. Functions are bound under the empty class name.
+
+   @param zend_class_entry *ce The class entry (NULL for functions)
+   @return bool Returns true if at least one method of the class (or function) has a binding
+*/
+bool php_rayaop_class_has_interceptors(zend_class_entry *ce) {
+    zend_string *name = ce ? ce->name : ZSTR_EMPTY_ALLOC(); /* Class name */
+    return (RAYAOP_G(intercept_classes) && zend_hash_exists(RAYAOP_G(intercept_classes), name)) ||
+           (RAYAOP_G(persistent_classes) && zend_hash_exists(RAYAOP_G(persistent_classes), name));
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_resolve_intercept_info(zend_function *func)
+   Function to resolve the intercept information of a function through the registry
+
+   Matchers are evaluated against the class on the first lookup of one of its methods, and
+   materializing a persistent binding registers it. Neither bumps the registry generation: they
+   only bind methods of a class (or a key) that no lookup of the current generation has seen, so
+   no cached result becomes stale. Functions are looked up under the empty class name
+   ("::function"). When the method is bound on at least one object, the result carries
+   PHP_RAYAOP_INSTANCE_TAG so that callers check the called object.
+
+   @param zend_function *func The called method or function
+   @return php_rayaop_intercept_info* Pointer to the intercept information (possibly tagged) if found, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_resolve_intercept_info(zend_function *func) {
+    zend_class_entry *scope = func->common.scope; /* Declaring class (NULL for functions) */
+
+    if (!RAYAOP_G(intercept_ht)) {
+        return NULL; /* Outside of a request */
+    }
+    if (UNEXPECTED(zend_hash_num_elements(RAYAOP_G(matchers)) > 0) && scope && !zend_hash_exists(RAYAOP_G(matched_classes), scope->name)) {
+        php_rayaop_batch_begin();
+        php_rayaop_apply_matchers(scope); /* First lookup of a method of this class */
+        php_rayaop_batch_end(false);
+    }
+    if (!php_rayaop_class_has_interceptors(scope)) {
+        return NULL; /* No binding for any method of the class */
+    }
+
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    zend_string *class_name = scope ? scope->name : ZSTR_EMPTY_ALLOC();
+    char *key = php_rayaop_build_intercept_key(buf, ZSTR_VAL(class_name), ZSTR_LEN(class_name),
+        ZSTR_VAL(func->common.function_name), ZSTR_LEN(func->common.function_name), &key_len);
+    php_rayaop_intercept_info *info = php_rayaop_find_intercept_info(key, key_len); /* Search for intercept information */
+    if (!info) {
+        php_rayaop_batch_begin();
+        info = php_rayaop_materialize_persistent_info(key, key_len); /* Fall back to persistent bindings */
+        php_rayaop_batch_end(false);
+    }
+    if (UNEXPECTED(RAYAOP_G(instance_methods) && zend_hash_num_elements(RAYAOP_G(instance_methods)) > 0) && zend_hash_str_exists(RAYAOP_G(instance_methods), key, key_len)) {
+        info = (php_rayaop_intercept_info *) ((uintptr_t) info | PHP_RAYAOP_INSTANCE_TAG); /* Objects have their own interceptors */
+    }
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    return info;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_cached_intercept_info(zend_execute_data *execute_data)
+   Function to look up the resolved intercept information through the per-function cache
+
+   The result of the registry lookup is cached in the run-time cache of the executed op_array together
+   with the registry generation it was computed for. As long as no binding is registered, the lookup is
+   a pointer load and compare. After a change, methods of classes without interceptors are rejected
+   by the class mark; the key is only generated and hashed for classes that have bindings.
+
+   @param zend_execute_data *execute_data Execution data of a user method
+   @return php_rayaop_intercept_info* Pointer to the intercept information (possibly tagged) if found, NULL otherwise
+*/
+static zend_always_inline php_rayaop_intercept_info *php_rayaop_cached_intercept_info(zend_execute_data *execute_data) {
+    void **cache = (void **) execute_data->run_time_cache; /* Run-time cache of the executed op_array */
+    void *generation = (void *) RAYAOP_G(generation); /* Current registry generation */
+
+    if (EXPECTED(cache[php_rayaop_cache_generation_handle] == generation)) {
+        /* Cached result is still valid */
+        return cache[php_rayaop_cache_info_handle];
+    }
+
+    php_rayaop_intercept_info *info = php_rayaop_resolve_intercept_info(execute_data->func); /* Resolve through the registry */
+    cache[php_rayaop_cache_info_handle] = info; /* Cache the result, including misses */
+    cache[php_rayaop_cache_generation_handle] = (void *) RAYAOP_G(generation); /* Stamp it with the current generation */
+    return info;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_dispatch_instance(zend_execute_data *execute_data, php_rayaop_intercept_info *info)
+   Function to turn a resolved lookup into the chain of the called object
+
+   @param zend_execute_data *execute_data The execution data of the call
+   @param php_rayaop_intercept_info *info The resolved intercept information (possibly tagged)
+   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+*/
+static zend_always_inline php_rayaop_intercept_info *php_rayaop_dispatch_instance(zend_execute_data *execute_data, php_rayaop_intercept_info *info) {
+    if (EXPECTED(!((uintptr_t) info & PHP_RAYAOP_INSTANCE_TAG))) {
+        return info; /* No object has its own interceptors for the method */
+    }
+    return php_rayaop_instance_intercept_info(execute_data, (php_rayaop_intercept_info *) ((uintptr_t) info & ~PHP_RAYAOP_INSTANCE_TAG));
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_lookup_intercept_info(zend_execute_data *execute_data)
+   Function to look up intercept information through the per-function cache
+
+   @param zend_execute_data *execute_data Execution data of a user method
+   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_lookup_intercept_info(zend_execute_data *execute_data) {
+    return php_rayaop_dispatch_instance(execute_data, php_rayaop_cached_intercept_info(execute_data));
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_lookup_internal_intercept_info(zend_execute_data *execute_data)
+   Function to look up intercept information of an internal function or method through the per-function cache
+
+   Internal functions have no run-time cache slots, so results are cached in a request table keyed
+   by the zend_function pointer, which is emptied whenever the registry generation changes.
+
+   @param zend_execute_data *execute_data The execution data of an internal function or method call
+   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_lookup_internal_intercept_info(zend_execute_data *execute_data) {
+    HashTable *cache = RAYAOP_G(internal_cache); /* Lookup cache of internal functions */
+
+    if (EXPECTED(cache && RAYAOP_G(internal_cache_generation) == RAYAOP_G(generation))) {
+        zval *cached = zend_hash_index_find(cache, (zend_ulong) (uintptr_t) execute_data->func);
+        if (EXPECTED(cached)) {
+            /* Cached result is still valid */
+            return php_rayaop_dispatch_instance(execute_data, Z_PTR_P(cached));
+        }
+    } else if (!cache) {
+        ALLOC_HASHTABLE(cache); /* Freed at request shutdown */
+        zend_hash_init(cache, 8, NULL, NULL, 0);
+        RAYAOP_G(internal_cache) = cache;
+    }
+
+    php_rayaop_intercept_info *info = php_rayaop_resolve_intercept_info(execute_data->func); /* Resolve through the registry */
+    if (RAYAOP_G(internal_cache_generation) != RAYAOP_G(generation)) {
+        zend_hash_clean(cache); /* Registry changed since the last lookup */
+        RAYAOP_G(internal_cache_generation) = RAYAOP_G(generation);
+    }
+    zval entry;
+    ZVAL_PTR(&entry, info);
+    zend_hash_index_update(cache, (zend_ulong) (uintptr_t) execute_data->func, &entry); /* Cache the result, including misses */
+    return php_rayaop_dispatch_instance(execute_data, info);
+}
+/* }}} */
+
+/* {{{ proto zval* php_rayaop_frame_arg(zend_execute_data *execute_data, uint32_t n)
+   Function to get an argument of a frame that has been initialized but not executed
+
+   Declared arguments stay in their call slots; arguments beyond the declared ones are moved
+   behind the compiled and temporary variables when the frame is initialized. Internal functions
+   keep all arguments in their call slots.
+
+   @param zend_execute_data *execute_data The execution data
+   @param uint32_t n Zero-based argument number (less than ZEND_CALL_NUM_ARGS)
+   @return zval* The argument
+*/
+PHP_RAYAOP_API zval *php_rayaop_frame_arg(zend_execute_data *execute_data, uint32_t n) {
+    zend_op_array *op_array = &execute_data->func->op_array;
+    if (EXPECTED(n < op_array->num_args) || execute_data->func->type == ZEND_INTERNAL_FUNCTION) {
+        return ZEND_CALL_ARG(execute_data, n + 1); /* Declared argument */
+    }
+    return ZEND_CALL_VAR_NUM(execute_data, op_array->last_var + op_array->T + (n - op_array->num_args)); /* Extra argument */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_copy_frame_args(zend_execute_data *execute_data, zval *args)
+   Function to copy the arguments of a frame into an array
+
+   Positional arguments are appended in order; named arguments collected by a variadic parameter
+   keep their names, so the array can be passed on with call_user_func_array().
+
+   @param zend_execute_data *execute_data The execution data
+   @param zval *args Receives the new array
+*/
+void php_rayaop_copy_frame_args(zend_execute_data *execute_data, zval *args) {
+    uint32_t arg_count = ZEND_CALL_NUM_ARGS(execute_data);
+
+    array_init_size(args, arg_count);
+    for (uint32_t i = 0; i < arg_count; i++) {
+        zval *arg = php_rayaop_frame_arg(execute_data, i);
+        Z_TRY_ADDREF_P(arg);
+        add_next_index_zval(args, arg);
+    }
+
+    if (UNEXPECTED(ZEND_CALL_INFO(execute_data) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        zend_string *name;
+        zval *arg;
+        ZEND_HASH_FOREACH_STR_KEY_VAL(execute_data->extra_named_params, name, arg) {
+            Z_TRY_ADDREF_P(arg);
+            zend_hash_update(Z_ARRVAL_P(args), name, arg); /* Named argument */
+        } ZEND_HASH_FOREACH_END();
+    }
+}
+/* }}} */
+
+/* {{{ Helper function to prepare intercept parameters (the object, the called class of a static method, or null for a function) */
+static void prepare_intercept_params(zend_execute_data *execute_data, zval *params, php_rayaop_intercept_info *info) {
+    if (Z_TYPE(execute_data->This) == IS_OBJECT) {
+        ZVAL_OBJ(&params[0], Z_OBJ(execute_data->This));
+    } else if (execute_data->func->common.scope) {
+        ZVAL_STR_COPY(&params[0], Z_CE(execute_data->This) ? Z_CE(execute_data->This)->name : execute_data->func->common.scope->name); /* Late static binding class */
+    } else {
+        ZVAL_NULL(&params[0]);
+    }
+    ZVAL_STR_COPY(&params[1], info->method_name); /* Released again in cleanup_intercept */
+    php_rayaop_copy_frame_args(execute_data, &params[2]);
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_prepare_handler_fcc(zval *handler, zend_fcall_info_cache *fcc)
+   Function to resolve the method of an interceptor once at registration time
+
+   Interceptors implement Ray\Aop\MethodInterceptorInterface (intercept()) or
+   Ray\Aop\NativeMethodInterceptorInterface (invoke()), so the method is a regular method that can
+   be resolved from the class function table. Objects without such a method get an empty cache and
+   are called by name (e.g. through __call).
+
+   @param zval *handler The interceptor object
+   @param zend_fcall_info_cache *fcc Receives the prepared call information
+   @return bool Returns true if the handler is a native interceptor receiving a NativeMethodInvocation
+*/
+bool php_rayaop_prepare_handler_fcc(zval *handler, zend_fcall_info_cache *fcc) {
+    zend_class_entry *ce = Z_OBJCE_P(handler); /* Interceptor class */
+    bool native = instanceof_function(ce, ray_aop_native_method_interceptor_interface_ce); /* Interceptor style */
+
+    if (native) {
+        fcc->function_handler = zend_hash_str_find_ptr(&ce->function_table, "invoke", sizeof("invoke") - 1); /* Resolve invoke() */
+    } else {
+        fcc->function_handler = zend_hash_str_find_ptr(&ce->function_table, "intercept", sizeof("intercept") - 1); /* Resolve intercept() */
+    }
+    if (fcc->function_handler && !(fcc->function_handler->common.fn_flags & ZEND_ACC_PUBLIC)) {
+        fcc->function_handler = NULL; /* Non-public methods keep the visibility checks of a call by name */
+    }
+    fcc->object = Z_OBJ_P(handler); /* Borrowed from the intercept information */
+    fcc->called_scope = ce;
+    fcc->calling_scope = ce;
+    return native;
+}
+/* }}} */
+
+/* {{{ Helper function to call the intercept handler */
+static bool call_intercept_handler(zval *handler, zend_fcall_info_cache *fcc, zval *params, zval *retval) {
+    if (EXPECTED(fcc->function_handler)) {
+        /* Dispatch directly to the method resolved at registration time */
+        zend_call_known_function(fcc->function_handler, fcc->object, fcc->called_scope, retval, 3, params, NULL);
+        return true;
+    }
+
+    zval func_name;
+    ZVAL_STRING(&func_name, "intercept");
+
+    bool success = (call_user_function(NULL, handler, &func_name, retval, 3, params) == SUCCESS);
+
+    zval_ptr_dtor(&func_name);
+    return success;
+}
+/* }}} */
+
+/* {{{ Helper function to clean up after interception */
+static void cleanup_intercept(zval *params) {
+    zval_ptr_dtor(&params[0]); /* Only a class name is owned */
+    zval_ptr_dtor(&params[1]);
+    zval_ptr_dtor(&params[2]);
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_invocation* php_rayaop_find_reentry(zend_execute_data *execute_data)
+   Function to detect a classic interceptor calling its intercepted method again
+
+   Interceptors implementing Ray\Aop\MethodInterceptorInterface reach the next interceptor of the
+   chain (or the original method) by calling the method by name on the same object. Such a call is
+   recognized as the "proceed" of the innermost active invocation; every other call (including
+   nested intercepted methods and recursion inside the original method) is intercepted as usual.
+
+   @param zend_execute_data *execute_data The execution data of the new call
+   @return php_rayaop_invocation* The invocation that proceeds, NULL if the call must be intercepted
+*/
+php_rayaop_invocation *php_rayaop_find_reentry(zend_execute_data *execute_data) {
+    php_rayaop_invocation *invocation = RAYAOP_G(invocation); /* Innermost active invocation */
+
+    if (invocation && !invocation->info->handlers[invocation->index].native && !invocation->proceed_frame &&
+        invocation->execute_data->func == execute_data->func &&
+        Z_PTR(invocation->execute_data->This) == Z_PTR(execute_data->This)) {
+        return invocation;
+    }
+    return NULL;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_call_advice(php_rayaop_invocation *invocation, php_rayaop_handler *handler, zval *retval)
+   Function to run native advice registered by another extension
+
+   @param php_rayaop_invocation *invocation The active invocation
+   @param php_rayaop_handler *handler The chain entry holding the advice
+   @param zval *retval Receives the result (UNDEF on exception)
+*/
+static void php_rayaop_call_advice(php_rayaop_invocation *invocation, php_rayaop_handler *handler, zval *retval) {
+    const php_rayaop_advice *advice = handler->advice;
+
+    if (advice->before) {
+        advice->before(invocation->execute_data, handler->advice_data);
+        if (UNEXPECTED(EG(exception))) {
+            return; /* The call does not proceed */
+        }
+    }
+    if (advice->around) {
+        advice->around(invocation, retval, handler->advice_data);
+    } else {
+        php_rayaop_proceed(invocation, retval); /* Next interceptor or the original method */
+    }
+    if (advice->after) {
+        advice->after(invocation->execute_data, retval, handler->advice_data);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_invoke_handler(php_rayaop_invocation *invocation, zval *retval)
+   Function to call the interceptor at the current position of the chain
+
+   Native interceptors receive a Ray\Aop\NativeMethodInvocation; classic interceptors receive the
+   object, the method name and the arguments. Native advice of other extensions is called directly.
+
+   @param php_rayaop_invocation *invocation The active invocation
+   @param zval *retval Receives the result of the interceptor (UNDEF on exception)
+*/
+static void php_rayaop_invoke_handler(php_rayaop_invocation *invocation, zval *retval) {
+    php_rayaop_intercept_info *info = invocation->info;
+    php_rayaop_handler *handler = &info->handlers[invocation->index]; /* Current interceptor */
+
+    ZVAL_UNDEF(retval);
+    if (handler->advice) {
+        php_rayaop_call_advice(invocation, handler, retval);
+    } else if (handler->native) {
+        zval param;
+        php_rayaop_invocation_object_init(&param, invocation); /* Ray\Aop\NativeMethodInvocation */
+        zend_call_known_function(handler->fcc.function_handler, handler->fcc.object, handler->fcc.called_scope, retval, 1, &param, NULL);
+        php_rayaop_invocation_object_detach(&param); /* proceed() is only valid during the call */
+        zval_ptr_dtor(&param);
+    } else {
+        zval params[3];
+        prepare_intercept_params(invocation->execute_data, params, info);
+        if (!call_intercept_handler(&handler->object, &handler->fcc, params, retval)) {
+            php_error_docref(NULL, E_WARNING, "Interception failed for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+        }
+        cleanup_intercept(params);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_original_begin(php_rayaop_invocation *invocation)
+   Function to note the start of the original method of an invocation (rayaop.stats)
+
+   @param php_rayaop_invocation *invocation The active invocation
+*/
+static zend_always_inline void php_rayaop_original_begin(php_rayaop_invocation *invocation) {
+    if (UNEXPECTED(RAYAOP_G(stats))) {
+        invocation->original_start = php_hrtime_current();
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_original_end(php_rayaop_invocation *invocation)
+   Function to add the time spent in the original method to an invocation (rayaop.stats)
+
+   @param php_rayaop_invocation *invocation The active invocation
+*/
+static zend_always_inline void php_rayaop_original_end(php_rayaop_invocation *invocation) {
+    if (UNEXPECTED(RAYAOP_G(stats))) {
+        invocation->original_ns += php_hrtime_current() - invocation->original_start;
+    }
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_binding_stats* php_rayaop_stats_for(php_rayaop_intercept_info *info)
+   Function to get the statistics of a binding (rayaop.stats)
+
+   Statistics are kept by "class::method" in the worker's persistent table, so they survive chain
+   changes and requests. Intercept information remembers the entry after the first call.
+
+   @param php_rayaop_intercept_info *info The intercept information
+   @return php_rayaop_binding_stats* The statistics
+*/
+static php_rayaop_binding_stats *php_rayaop_stats_for(php_rayaop_intercept_info *info) {
+    if (EXPECTED(info->stats)) {
+        return info->stats;
+    }
+
+    if (!RAYAOP_G(stats_ht)) {
+        /* Allocated on first use, released at module shutdown */
+        RAYAOP_G(stats_ht) = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(RAYAOP_G(stats_ht), 8, NULL, php_rayaop_free_stats, 1);
+    }
+
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, ZSTR_VAL(info->class_name), ZSTR_LEN(info->class_name),
+        ZSTR_VAL(info->method_name), ZSTR_LEN(info->method_name), &key_len);
+    php_rayaop_binding_stats *stats = zend_hash_str_find_ptr(RAYAOP_G(stats_ht), key, key_len); /* Search for existing statistics */
+    if (!stats) {
+        stats = pecalloc(1, sizeof(php_rayaop_binding_stats), 1); /* First call of this binding in the worker */
+        zend_hash_str_add_new_ptr(RAYAOP_G(stats_ht), key, key_len, stats);
+    }
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+
+    info->stats = stats;
+    return stats;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_record_stats(php_rayaop_invocation *invocation, php_hrtime_t start)
+   Function to record an intercepted call (rayaop.stats)
+
+   Only the invocation starting a chain is counted; invocations started by a classic interceptor
+   proceeding to the next interceptor hand their original method time to the enclosing one.
+
+   @param php_rayaop_invocation *invocation The finished invocation
+   @param php_hrtime_t start The time the invocation started
+*/
+static void php_rayaop_record_stats(php_rayaop_invocation *invocation, php_hrtime_t start) {
+    if (invocation->index > 0 && invocation->prev) {
+        invocation->prev->original_ns += invocation->original_ns; /* Part of the enclosing call */
+        return;
+    }
+
+    php_rayaop_binding_stats *stats = php_rayaop_stats_for(invocation->info);
+    uint64_t elapsed = php_hrtime_current() - start;
+
+    stats->calls++;
+    stats->total_ns += elapsed;
+    stats->original_ns += invocation->original_ns;
+    if (elapsed > stats->max_ns) {
+        stats->max_ns = elapsed;
+    }
+    if (invocation->original_ns > stats->max_original_ns) {
+        stats->max_original_ns = invocation->original_ns;
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_call_original_internal(zend_execute_data *execute_data, zval *return_value)
+   Function to call an internal function the way the engine would have without this extension
+
+   @param zend_execute_data *execute_data The execution data of the internal call
+   @param zval *return_value Receives the result
+*/
+static void php_rayaop_call_original_internal(zend_execute_data *execute_data, zval *return_value) {
+    if (php_rayaop_original_execute_internal) {
+        php_rayaop_original_execute_internal(execute_data, return_value); /* Chain to another extension's hook */
+    } else {
+        execute_data->func->internal_function.handler(execute_data, return_value); /* Call the internal function directly */
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_proceed_internal(php_rayaop_invocation *invocation, zval *retval)
+   Function to execute the original internal method of an invocation in a fresh frame
+
+   @param php_rayaop_invocation *invocation The active invocation
+   @param zval *retval Receives the result of the original method (UNDEF on exception)
+*/
+static void php_rayaop_proceed_internal(php_rayaop_invocation *invocation, zval *retval) {
+    zend_execute_data *execute_data = invocation->execute_data; /* The intercepted frame */
+    zend_function *func = execute_data->func; /* The original method */
+    uint32_t num_args = ZEND_CALL_NUM_ARGS(execute_data); /* Number of passed arguments */
+
+    uint32_t call_info = ZEND_CALL_TOP_FUNCTION; /* Executed outside of the VM */
+
+    if (Z_TYPE(execute_data->This) == IS_OBJECT) {
+        call_info |= ZEND_CALL_HAS_THIS;
+    }
+
+    zend_execute_data *call = zend_vm_stack_push_call_frame(call_info, func, num_args, Z_PTR(execute_data->This)); /* Push a fresh frame */
+    for (uint32_t i = 0; i < num_args; i++) {
+        ZVAL_COPY(ZEND_CALL_ARG(call, i + 1), ZEND_CALL_ARG(execute_data, i + 1)); /* Pass the same arguments */
+    }
+    if (UNEXPECTED(ZEND_CALL_INFO(execute_data) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        call->extra_named_params = execute_data->extra_named_params; /* Share collected named arguments */
+        GC_ADDREF(call->extra_named_params);
+        ZEND_ADD_CALL_FLAG(call, ZEND_CALL_HAS_EXTRA_NAMED_PARAMS);
+    }
+
+    zend_execute_data *previous_frame = invocation->proceed_frame;
+    call->prev_execute_data = EG(current_execute_data);
+    EG(current_execute_data) = call;
+    invocation->proceed_frame = call;
+
+    ZVAL_NULL(retval);
+    php_rayaop_original_begin(invocation);
+    php_rayaop_call_original_internal(call, retval); /* Execute the original method */
+    php_rayaop_original_end(invocation);
+
+    invocation->proceed_frame = previous_frame;
+    EG(current_execute_data) = call->prev_execute_data;
+    zend_vm_stack_free_args(call);
+    if (UNEXPECTED(ZEND_CALL_INFO(call) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        zend_free_extra_named_params(call->extra_named_params);
+    }
+    zend_vm_stack_free_call_frame(call); /* Free the fresh frame */
+
+    if (UNEXPECTED(EG(exception))) {
+        zval_ptr_dtor(retval); /* The result of a throwing call is discarded */
+        ZVAL_UNDEF(retval);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_proceed(php_rayaop_invocation *invocation, zval *retval)
+   Function to execute the next interceptor of the chain or the original method of an invocation
+
+   While interceptors remain, the chain position is advanced and the next interceptor is called
+   with the same invocation. After the last interceptor, a fresh frame for the original
+   zend_function is pushed with copies of the intercepted frame's arguments and executed directly
+   by the original executor, so there is no lookup, no callable resolution and no re-entry into
+   the interception hook. It can be called any number of times.
+
+   @param php_rayaop_invocation *invocation The active invocation
+   @param zval *retval Receives the result (UNDEF on exception)
+*/
+PHP_RAYAOP_API void php_rayaop_proceed(php_rayaop_invocation *invocation, zval *retval) {
+    if (invocation->index + 1 < invocation->info->handler_count) {
+        invocation->index++; /* Advance to the next interceptor */
+        php_rayaop_invoke_handler(invocation, retval);
+        invocation->index--;
+        return;
+    }
+    if (invocation->execute_data->func->type == ZEND_INTERNAL_FUNCTION) {
+        php_rayaop_proceed_internal(invocation, retval);
+        return;
+    }
+
+    zend_execute_data *execute_data = invocation->execute_data; /* The intercepted frame */
+    zend_function *func = execute_data->func; /* The original method */
+    uint32_t num_args = ZEND_CALL_NUM_ARGS(execute_data); /* Number of passed arguments */
+    uint32_t call_info = ZEND_CALL_TOP_FUNCTION; /* Executed by a separate executor invocation */
+
+    if (Z_TYPE(execute_data->This) == IS_OBJECT) {
+        call_info |= ZEND_CALL_HAS_THIS;
+    }
+
+    zend_execute_data *call = zend_vm_stack_push_call_frame(call_info, func, num_args, Z_PTR(execute_data->This)); /* Push a fresh frame */
+    for (uint32_t i = 0; i < num_args; i++) {
+        ZVAL_COPY(ZEND_CALL_ARG(call, i + 1), php_rayaop_frame_arg(execute_data, i)); /* Pass the same arguments */
+    }
+    if (UNEXPECTED(ZEND_CALL_INFO(execute_data) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        call->extra_named_params = execute_data->extra_named_params; /* Share collected named arguments */
+        GC_ADDREF(call->extra_named_params);
+        ZEND_ADD_CALL_FLAG(call, ZEND_CALL_HAS_EXTRA_NAMED_PARAMS);
+    }
+    if (UNEXPECTED(func->common.fn_flags & ZEND_ACC_CLOSURE)) {
+        GC_ADDREF(ZEND_CLOSURE_OBJECT(func)); /* Released when the frame leaves */
+        ZEND_ADD_CALL_FLAG(call, (func->common.fn_flags & ZEND_ACC_FAKE_CLOSURE) ? (ZEND_CALL_CLOSURE | ZEND_CALL_FAKE_CLOSURE) : ZEND_CALL_CLOSURE);
+    }
+
+    zend_execute_data *previous_frame = invocation->proceed_frame;
+    uint32_t orig_jit_trace_num = EG(jit_trace_num);
+
+    ZVAL_UNDEF(retval);
+    zend_init_func_execute_data(call, &func->op_array, retval); /* Initialize the frame (receives arguments) */
+    invocation->proceed_frame = call; /* Calls made by the original method are intercepted again */
+    if (ZEND_OBSERVER_ENABLED) {
+        zend_observer_fcall_begin(call); /* Keep observers balanced (ignored by this extension's begin handler) */
+    }
+    php_rayaop_original_begin(invocation);
+    php_rayaop_original_execute_ex(call); /* Execute the original method */
+    php_rayaop_original_end(invocation);
+    invocation->proceed_frame = previous_frame;
+    EG(jit_trace_num) = orig_jit_trace_num;
+
+    zend_vm_stack_free_call_frame(call); /* Free the fresh frame */
+}
+/* }}} */
+
+/* {{{ proto const char* php_rayaop_probe_interceptor(php_rayaop_intercept_info *info, uint32_t index)
+   Function to name the interceptor at a chain position for the USDT probes
+
+   @param php_rayaop_intercept_info *info The intercept information
+   @param uint32_t index The position in the interceptor chain
+   @return const char* The class of the interceptor, or an empty string for native advice
+*/
+static const char *php_rayaop_probe_interceptor(php_rayaop_intercept_info *info, uint32_t index) {
+    zval *object = &info->handlers[index].object;
+    return Z_TYPE_P(object) == IS_OBJECT ? ZSTR_VAL(Z_OBJCE_P(object)->name) : "";
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_probe_rejected(zend_execute_data *execute_data)
+   Function to fire the rejection probe for a call that was not intercepted
+
+   @param zend_execute_data *execute_data The execution data of the call
+*/
+static void php_rayaop_probe_rejected(zend_execute_data *execute_data) {
+    zend_function *func = execute_data->func;
+    PHP_RAYAOP_PROBE(intercept__rejected, func->common.scope ? ZSTR_VAL(func->common.scope->name) : "",
+                     func->common.function_name ? ZSTR_VAL(func->common.function_name) : "");
+    (void) func; /* Unused without probes */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_call_interceptor(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index, zval *retval)
+   Function to call the intercept handler in place of the original method
+
+   This function is shared by all interception backends. It pushes an invocation for the
+   (not yet executed) frame of a method, static method or function, calls the interceptor at the
+   given chain position and stores its result in retval. The invocation holds a reference to the
+   intercept information, so the chain may be changed by the interceptors themselves.
+
+   @param zend_execute_data *execute_data The execution data of the intercepted call
+   @param php_rayaop_intercept_info *info The intercept information
+   @param uint32_t index The position in the interceptor chain to start from
+   @param zval *retval Receives the result of the intercept handler
+   @return bool Returns true if the call was handled, false if the original method must be executed
+*/
+bool php_rayaop_call_interceptor(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index, zval *retval) {
+    PHP_RAYAOP_DEBUG_PRINT("Executing intercept for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+
+    php_rayaop_invocation invocation; /* Lives until the handler returns */
+    invocation.execute_data = execute_data;
+    invocation.info = info;
+    invocation.index = index;
+    invocation.proceed_frame = NULL;
+    invocation.reentered = false;
+    invocation.original_ns = 0;
+    invocation.original_start = 0;
+    ZVAL_UNDEF(&invocation.argument_view);
+    invocation.prev = RAYAOP_G(invocation);
+    RAYAOP_G(invocation) = &invocation; /* Push */
+    info->refcount++; /* Keep the chain alive while it is walked */
+
+    if (PHP_RAYAOP_PROBE_ENABLED(intercept__entry)) {
+        PHP_RAYAOP_PROBE(intercept__entry, ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name), php_rayaop_probe_interceptor(info, index));
+    }
+    bool probe_return = PHP_RAYAOP_PROBE_ENABLED(intercept__return); /* Sampled once, so the elapsed time has a start */
+    php_hrtime_t start = (UNEXPECTED(RAYAOP_G(stats)) || probe_return) ? php_hrtime_current() : 0; /* Start of the intercepted call */
+    php_rayaop_invoke_handler(&invocation, retval);
+    if (Z_ISUNDEF_P(retval)) {
+        ZVAL_NULL(retval); /* Callers always receive an initialized result */
+    }
+    if (UNEXPECTED(RAYAOP_G(stats))) {
+        php_rayaop_record_stats(&invocation, start);
+    }
+    if (probe_return) {
+        PHP_RAYAOP_PROBE(intercept__return, ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name), php_rayaop_probe_interceptor(info, index),
+                         (uint64_t) (php_hrtime_current() - start));
+    }
+
+    RAYAOP_G(invocation) = invocation.prev; /* Pop */
+    if (!Z_ISUNDEF(invocation.argument_view)) {
+        php_rayaop_invocation_object_detach(&invocation.argument_view); /* The view must not outlive the frame */
+        zval_ptr_dtor(&invocation.argument_view);
+    }
+    PHP_RAYAOP_DEBUG_PRINT("Interception completed for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+    php_rayaop_release_intercept_info(info);
+    return true;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_release_frame(zend_execute_data *execute_data)
+   Function to release a frame that was intercepted instead of executed
+
+   This function performs the cleanup the VM leave helper would have done for a top-level call:
+   it frees the compiled variables (including the received arguments), extra arguments, extra
+   named parameters and the closure, and restores the current execute data.
+
+   @param zend_execute_data *execute_data The execution data of the intercepted call
+*/
+void php_rayaop_release_frame(zend_execute_data *execute_data) {
+    uint32_t call_info = ZEND_CALL_INFO(execute_data); /* Get call information flags */
+
+    zend_free_compiled_variables(execute_data); /* Free compiled variables */
+    zend_vm_stack_free_extra_args(execute_data); /* Free arguments beyond the declared ones */
+    if (UNEXPECTED(call_info & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        zend_free_extra_named_params(execute_data->extra_named_params); /* Free collected named arguments */
+    }
+    if (UNEXPECTED(call_info & ZEND_CALL_CLOSURE)) {
+        OBJ_RELEASE(ZEND_CLOSURE_OBJECT(execute_data->func)); /* Release the closure object */
+    }
+    EG(current_execute_data) = execute_data->prev_execute_data; /* Return control to the caller frame */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index)
+   Main function to execute method interception (zend_execute_ex backend) */
+void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info, uint32_t index) {
+    zval retval;
+
+    if (!php_rayaop_call_interceptor(execute_data, info, index, &retval)) {
+        php_rayaop_original_execute_ex(execute_data); /* Call the original execution function */
+        return;
+    }
+
+    if (execute_data->return_value) {
+        ZVAL_COPY_VALUE(execute_data->return_value, &retval); /* Hand the result over to the caller */
+    } else {
+        zval_ptr_dtor(&retval); /* Result is not used by the caller */
+    }
+    php_rayaop_release_frame(execute_data); /* The original frame is never executed */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_observer_return(zend_execute_data *execute_data, zval *retval)
+   Function to make an observed frame return the interceptor's result (observer backend)
+
+   Observer begin handlers cannot skip a function, so the frame is redirected to a synthetic
+   "return" opline instead. The result is stored beforehand and the frame's return value pointer
+   cleared, so the synthetic return leaves the frame through the regular VM leave path (which
+   also runs the end handlers of other observers) without touching the result.
+
+   @param zend_execute_data *execute_data The execution data of the intercepted call
+   @param zval *retval The result of the intercept handler (ownership is taken)
+*/
+static void php_rayaop_observer_return(zend_execute_data *execute_data, zval *retval) {
+    if (UNEXPECTED(php_rayaop_return_op.op.handler == NULL)) {
+        /* Resolve the opcode handler once the observer state of the VM is final */
+        php_rayaop_return_op.op.opcode = ZEND_RETURN;
+        php_rayaop_return_op.op.op1_type = IS_CONST;
+        php_rayaop_return_op.op.op2_type = IS_UNUSED;
+        php_rayaop_return_op.op.result_type = IS_UNUSED;
+        ZVAL_NULL(&php_rayaop_return_op.value);
+#if ZEND_USE_ABS_CONST_ADDR
+        php_rayaop_return_op.op.op1.zv = &php_rayaop_return_op.value;
+#else
+        php_rayaop_return_op.op.op1.constant = (uint32_t) ((char *) &php_rayaop_return_op.value - (char *) &php_rayaop_return_op.op);
+#endif
+        zend_vm_set_opcode_handler(&php_rayaop_return_op.op);
+    }
+
+    if (execute_data->return_value) {
+        ZVAL_COPY_VALUE(execute_data->return_value, retval); /* Hand the result over to the caller */
+        execute_data->return_value = NULL; /* The synthetic return must not overwrite it */
+    } else {
+        zval_ptr_dtor(retval); /* Result is not used by the caller */
+    }
+
+    execute_data->opline = &php_rayaop_return_op.op; /* Used when the VM (re)loads the opline */
+    RAYAOP_G(pending_return) = execute_data; /* Re-applied from the interrupt handler */
+#if PHP_VERSION_ID >= 80200
+    zend_atomic_bool_store_ex(&EG(vm_interrupt), true); /* Force the VM to reload the opline */
+#else
+    EG(vm_interrupt) = 1; /* Force the VM to reload the opline */
+#endif
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_interrupt_function(zend_execute_data *execute_data)
+   VM interrupt handler (observer backend)
+
+   The VM saves its current opline before calling the interrupt handler, so the redirection to
+   the synthetic return opline is re-applied here and picked up when the VM re-enters the frame.
+
+   @param zend_execute_data *execute_data The execution data of the interrupted frame
+*/
+static void php_rayaop_interrupt_function(zend_execute_data *execute_data) {
+    if (RAYAOP_G(pending_return) == execute_data) {
+        RAYAOP_G(pending_return) = NULL;
+        execute_data->opline = &php_rayaop_return_op.op; /* Leave the frame with the interceptor's result */
+    }
+    if (php_rayaop_original_interrupt_function) {
+        php_rayaop_original_interrupt_function(execute_data); /* Chain to the previous interrupt handler */
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_observer_begin(zend_execute_data *execute_data)
+   Observer begin handler (observer backend)
+
+   This handler is only attached to functions that had a binding when they were first called.
+
+   @param zend_execute_data *execute_data The execution data of the observed call
+*/
+static void php_rayaop_observer_begin(zend_execute_data *execute_data) {
+    RAYAOP_G(pending_return) = NULL; /* Drop a redirection the VM never picked up */
+
+    if (RAYAOP_G(invocation) && RAYAOP_G(invocation)->proceed_frame == execute_data) {
+        return; /* Frame pushed by php_rayaop_proceed() */
+    }
+    if (!php_rayaop_should_intercept(execute_data)) {
+        return; /* The original function runs */
+    }
+
+    php_rayaop_intercept_info *info = php_rayaop_lookup_intercept_info(execute_data); /* Search for intercept information */
+    if (!info) {
+        return;
+    }
+
+    uint32_t index = 0; /* Chain position */
+    php_rayaop_invocation *reentry = php_rayaop_find_reentry(execute_data);
+    if (reentry) {
+        if (reentry->index + 1 >= reentry->info->handler_count) {
+            reentry->proceed_frame = execute_data; /* The original function runs; cleared by the end handler */
+            reentry->reentered = true;
+            php_rayaop_original_begin(reentry);
+            return;
+        }
+        info = reentry->info; /* The next interceptor sees the arguments of this call */
+        index = reentry->index + 1;
+    } else if (!php_rayaop_sample(info)) {
+        return; /* Not sampled: the original function runs */
+    }
+
+    zval retval;
+    if (php_rayaop_call_interceptor(execute_data, info, index, &retval)) {
+        php_rayaop_observer_return(execute_data, &retval);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_observer_end(zend_execute_data *execute_data, zval *retval)
+   Observer end handler (observer backend)
+
+   @param zend_execute_data *execute_data The execution data of the observed call
+   @param zval *retval The return value
+*/
+static void php_rayaop_observer_end(zend_execute_data *execute_data, zval *retval) {
+    php_rayaop_invocation *invocation = RAYAOP_G(invocation); /* Innermost active invocation */
+    if (invocation && invocation->reentered && invocation->proceed_frame == execute_data) {
+        invocation->proceed_frame = NULL; /* The classic interceptor's call has returned */
+        invocation->reentered = false;
+        php_rayaop_original_end(invocation);
+    }
+}
+/* }}} */
+
+/* {{{ proto zend_observer_fcall_handlers php_rayaop_observer_init(zend_execute_data *execute_data)
+   Observer initialization handler (observer backend)
+
+   Called by the engine once per function and request. Only functions with a binding get a begin
+   handler, so all other calls run without any involvement of this extension. Functions that gain
+   a binding later are handled by php_rayaop_observer_attach().
+
+   @param zend_execute_data *execute_data The execution data of the first call
+   @return zend_observer_fcall_handlers Handlers to attach to the function
+*/
+static zend_observer_fcall_handlers php_rayaop_observer_init(zend_execute_data *execute_data) {
+    zend_observer_fcall_handlers handlers = {NULL, NULL};
+    zend_function *func = execute_data->func;
+
+    if (func->type == ZEND_USER_FUNCTION && func->common.function_name &&
+        php_rayaop_cached_intercept_info(execute_data)) {
+        handlers.begin = php_rayaop_observer_begin; /* Attach only to intercepted functions (or methods bound on objects) */
+        handlers.end = php_rayaop_observer_end;
+        ((void **) execute_data->run_time_cache)[php_rayaop_cache_observed_handle] = func; /* Never attached twice */
+    }
+    return handlers;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_observer_attach(zend_function *func)
+   Function to attach the observer handlers to a function that gained a binding (observer backend)
+
+   A function called before its first binding was registered has been initialized without
+   handlers for the rest of the request. Since PHP 8.2 the handlers are added to it on the spot;
+   PHP 8.1 cannot change them and warns instead. Functions that were not called yet are left to
+   php_rayaop_observer_init().
+
+   @param zend_function *func The function or method
+*/
+static void php_rayaop_observer_attach(zend_function *func) {
+    if (php_rayaop_backend != PHP_RAYAOP_BACKEND_OBSERVER || func->type != ZEND_USER_FUNCTION) {
+        return;
+    }
+    void **cache = RUN_TIME_CACHE(&func->op_array); /* Allocated on the first call of the request */
+    if (!cache || !cache[zend_observer_fcall_op_array_extension] || cache[php_rayaop_cache_observed_handle]) {
+        return; /* Not initialized yet, or attached already */
+    }
+
+    cache[php_rayaop_cache_observed_handle] = func; /* Attached (or reported) once per request */
+#if PHP_VERSION_ID >= 80200
+    zend_observer_add_begin_handler(func, php_rayaop_observer_begin);
+    zend_observer_add_end_handler(func, php_rayaop_observer_end);
+#else
+    php_error_docref(NULL, E_WARNING, "%s%s%s() has been called before its binding was registered, the observer backend intercepts it from the next request on",
+        func->common.scope ? ZSTR_VAL(func->common.scope->name) : "", func->common.scope ? "::" : "", ZSTR_VAL(func->common.function_name));
+#endif
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_observer_attach_name(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len)
+   Function to attach the observer handlers to a function or method by name (observer backend)
+
+   Classes are not autoloaded: a class declared later is observed from the first call of its methods.
+
+   @param const char *class_name The name of the class (empty for a function)
+   @param size_t class_name_len The length of the class name
+   @param const char *method_name The name of the method or function
+   @param size_t method_name_len The length of the method name
+*/
+static void php_rayaop_observer_attach_name(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len) {
+    if (php_rayaop_backend != PHP_RAYAOP_BACKEND_OBSERVER) {
+        return;
+    }
+    HashTable *functions = EG(function_table); /* Functions are bound under the empty class name */
+    if (class_name_len > 0) {
+        zend_class_entry *ce = zend_hash_str_find_ptr_lc(EG(class_table), class_name, class_name_len);
+        if (!ce) {
+            return; /* Not declared yet */
+        }
+        functions = &ce->function_table;
+    }
+    zend_function *func = zend_hash_str_find_ptr_lc(functions, method_name, method_name_len);
+    if (func) {
+        php_rayaop_observer_attach(func);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_fiber_init(zend_fiber_context *context)
+   Fiber initialization observer
+
+   @param zend_fiber_context *context The new fiber context
+*/
+static void php_rayaop_fiber_init(zend_fiber_context *context) {
+    context->reserved[php_rayaop_fiber_handle] = NULL; /* A new fiber starts without active invocations */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_fiber_switch(zend_fiber_context *from, zend_fiber_context *to)
+   Fiber switch observer
+
+   Invocations live on the C stack of the fiber that started them. An interceptor may suspend its
+   fiber, so each fiber keeps its own invocation stack: otherwise calls in other fibers would be
+   taken for the proceed of the suspended interceptor, and the stack would be popped out of order.
+
+   @param zend_fiber_context *from The suspended (or finished) fiber context
+   @param zend_fiber_context *to The resumed fiber context
+*/
+static void php_rayaop_fiber_switch(zend_fiber_context *from, zend_fiber_context *to) {
+    from->reserved[php_rayaop_fiber_handle] = RAYAOP_G(invocation); /* Park the stack of the suspended fiber */
+    RAYAOP_G(invocation) = to->reserved[php_rayaop_fiber_handle]; /* Restore the stack of the resumed fiber */
+}
+/* }}} */
+
+/* {{{ proto uint32_t php_rayaop_chain_class(uint32_t handler_count, size_t *capacity)
+   Function to get the size class of an interceptor chain in the binding arena
+
+   @param uint32_t handler_count The number of interceptors
+   @param size_t *capacity Pointer to store the number of interceptors the allocation has room for
+   @return uint32_t The index of the list of released chains of the class
+*/
+static zend_always_inline uint32_t php_rayaop_chain_class(uint32_t handler_count, size_t *capacity) {
+    if (EXPECTED(handler_count <= PHP_RAYAOP_ARENA_EXACT_HANDLERS)) {
+        *capacity = handler_count;
+        return handler_count - 1; /* One class per length */
+    }
+
+    uint64_t cap = PHP_RAYAOP_ARENA_EXACT_HANDLERS * 2; /* Longer chains are rounded up to a power of two */
+    uint32_t index = PHP_RAYAOP_ARENA_EXACT_HANDLERS;
+    while (cap < handler_count) {
+        cap <<= 1;
+        index++;
+    }
+    *capacity = (size_t) cap;
+    return index;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_alloc_intercept_info(zend_string *class_name, zend_string *method_name, uint32_t handler_count)
+   Function to allocate intercept information with room for an interceptor chain
+
+   The chain is stored inline, so a binding is a single allocation. Chains of every length are
+   carved out of the request arena, which keeps the bindings of a request next to each other
+   and avoids one allocator round trip per registration; released chains are kept in a list per
+   size class (see php_rayaop_chain_class()) and reused. The caller fills in all handler_count
+   handlers.
+
+   @param zend_string *class_name The name of the class (a new reference is taken)
+   @param zend_string *method_name The name of the method (a new reference is taken)
+   @param uint32_t handler_count The number of interceptors
+   @return php_rayaop_intercept_info* The new intercept information with a reference count of 1
+*/
+php_rayaop_intercept_info *php_rayaop_alloc_intercept_info(zend_string *class_name, zend_string *method_name, uint32_t handler_count) {
+    size_t capacity;
+    uint32_t index = php_rayaop_chain_class(handler_count, &capacity); /* Size class of the chain */
+    php_rayaop_intercept_info *info = RAYAOP_G(free_infos)[index]; /* Reuse a released chain of the same class */
+
+    if (info) {
+        RAYAOP_G(free_infos)[index] = *(php_rayaop_intercept_info **) info;
+    } else {
+        if (!RAYAOP_G(arena)) {
+            RAYAOP_G(arena) = zend_arena_create(PHP_RAYAOP_ARENA_SIZE); /* First binding of the request */
+        }
+        size_t size = sizeof(php_rayaop_intercept_info) + (capacity - 1) * sizeof(php_rayaop_handler); /* Size with the inline chain */
+        info = zend_arena_alloc(&RAYAOP_G(arena), size); /* Allocate from the binding arena (chunks larger than PHP_RAYAOP_ARENA_SIZE for long chains) */
+    }
+
+    info->class_name = zend_string_copy(class_name);
+    info->method_name = zend_string_copy(method_name);
+    info->refcount = 1; /* Owned by the registry */
+    info->stats = NULL; /* Resolved on the first recorded call */
+    info->handler_count = handler_count;
+    info->sample_rate = 1; /* Every call is intercepted */
+    return info;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_release_intercept_info(php_rayaop_intercept_info *info)
+   Function to release a reference to intercept information
+
+   The information is freed when neither the registry nor an active invocation uses it.
+
+   @param php_rayaop_intercept_info *info The intercept information
+*/
+void php_rayaop_release_intercept_info(php_rayaop_intercept_info *info) {
+    if (--info->refcount > 0) {
+        return; /* Still in use */
+    }
+
+    PHP_RAYAOP_DEBUG_PRINT("Freeing intercept info for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+    /* Output debug information */
+    zend_string_release(info->class_name); /* Free memory for class name */
+    zend_string_release(info->method_name); /* Free memory for method name */
+    for (uint32_t i = 0; i < info->handler_count; i++) {
+        zval_ptr_dtor(&info->handlers[i].object); /* Free memory for handler */
+    }
+    size_t capacity;
+    uint32_t index = php_rayaop_chain_class(info->handler_count, &capacity); /* Size class of the chain */
+    *(php_rayaop_intercept_info **) info = RAYAOP_G(free_infos)[index]; /* Arena memory is reused, not freed */
+    RAYAOP_G(free_infos)[index] = info;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_free_intercept_info(zval *zv)
+   Function to free intercept information
+
+   This function releases the registry's reference to intercept information.
+
+   @param zval *zv The zval containing the intercept information to be freed
+*/
+void php_rayaop_free_intercept_info(zval *zv) {
+    php_rayaop_intercept_info *info = Z_PTR_P(zv); /* Get intercept information pointer from zval */
+    if (info) {
+        /* If intercept information exists */
+        php_rayaop_release_intercept_info(info);
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_execute_ex(zend_execute_data *execute_data)
+   Custom zend_execute_ex function
+
+   This function replaces the original zend_execute_ex function to implement method interception.
+
+   @param zend_execute_data *execute_data The execution data
+*/
+static void php_rayaop_execute_ex(zend_execute_data *execute_data) {
+    PHP_RAYAOP_DEBUG_PRINT("php_rayaop_execute_ex called"); /* Output debug information */
+
+    php_rayaop_intercept_info *info = NULL;
+    if (php_rayaop_should_intercept(execute_data)) {
+        info = php_rayaop_lookup_intercept_info(execute_data); /* Search for intercept information */
+    }
+
+    if (!info) {
+        /* If intercept information is not found */
+        if (UNEXPECTED(RAYAOP_G(stats))) {
+            RAYAOP_G(stats_rejected)++; /* Rejected on the fast path */
+        }
+        if (PHP_RAYAOP_PROBE_ENABLED(intercept__rejected)) {
+            php_rayaop_probe_rejected(execute_data);
+        }
+        php_rayaop_original_execute_ex(execute_data); /* Call the original execution function */
+        return;
+    }
+
+    php_rayaop_invocation *reentry = php_rayaop_find_reentry(execute_data);
+    if (reentry) {
+        if (reentry->index + 1 < reentry->info->handler_count) {
+            /* A classic interceptor proceeds to the next interceptor, which sees the arguments of this call */
+            php_rayaop_execute_intercept(execute_data, reentry->info, reentry->index + 1);
+            return;
+        }
+        /* A classic interceptor calls the original method */
+        reentry->proceed_frame = execute_data;
+        php_rayaop_original_begin(reentry);
+        php_rayaop_original_execute_ex(execute_data); /* Call the original execution function */
+        php_rayaop_original_end(reentry);
+        reentry->proceed_frame = NULL;
+        return;
+    }
+    if (!php_rayaop_sample(info)) {
+        php_rayaop_original_execute_ex(execute_data); /* Not sampled: no invocation is set up */
+        return;
+    }
+
+    PHP_RAYAOP_DEBUG_PRINT("Found intercept info for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name)); /* Output debug information */
+    php_rayaop_execute_intercept(execute_data, info, 0); /* Execute interception */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_execute_internal(zend_execute_data *execute_data, zval *return_value)
+   Custom zend_execute_internal function (rayaop.intercept_internal)
+
+   Internal functions and methods (strlen(), PDO::query(), Redis::get(), ...) never go through
+   zend_execute_ex. Every call that passes php_rayaop_should_intercept() is looked up in the
+   per-function cache of the request, which also remembers misses, and calls without a binding go
+   straight to the original.
+
+   @param zend_execute_data *execute_data The execution data of the internal call
+   @param zval *return_value The return value (initialized to NULL by the caller)
+*/
+static void php_rayaop_execute_internal(zend_execute_data *execute_data, zval *return_value) {
+    php_rayaop_intercept_info *info = NULL;
+    if (php_rayaop_should_intercept(execute_data)) {
+        info = php_rayaop_lookup_internal_intercept_info(execute_data); /* Search for intercept information */
+    }
+    if (EXPECTED(!info)) {
+        if (UNEXPECTED(RAYAOP_G(stats))) {
+            RAYAOP_G(stats_rejected)++; /* Rejected on the fast path */
+        }
+        if (PHP_RAYAOP_PROBE_ENABLED(intercept__rejected)) {
+            php_rayaop_probe_rejected(execute_data);
+        }
+        php_rayaop_call_original_internal(execute_data, return_value);
+        return;
+    }
+
+    uint32_t index = 0; /* Chain position */
+    php_rayaop_invocation *reentry = php_rayaop_find_reentry(execute_data);
+    if (reentry) {
+        if (reentry->index + 1 >= reentry->info->handler_count) {
+            /* A classic interceptor calls the original method */
+            reentry->proceed_frame = execute_data;
+            php_rayaop_original_begin(reentry);
+            php_rayaop_call_original_internal(execute_data, return_value);
+            php_rayaop_original_end(reentry);
+            reentry->proceed_frame = NULL;
+            return;
+        }
+        info = reentry->info; /* The next interceptor sees the arguments of this call */
+        index = reentry->index + 1;
+    } else if (!php_rayaop_sample(info)) {
+        php_rayaop_call_original_internal(execute_data, return_value); /* Not sampled */
+        return;
+    }
+
+    zval retval;
+    if (!php_rayaop_call_interceptor(execute_data, info, index, &retval)) {
+        php_rayaop_call_original_internal(execute_data, return_value);
+        return;
+    }
+    zval_ptr_dtor(return_value);
+    ZVAL_COPY_VALUE(return_value, &retval); /* Hand the result over to the caller (the caller frees the arguments) */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_has_bindings(void)
+   Function to check whether anything could be intercepted in the current request
+
+   @return bool Returns true if a binding, persistent binding, matcher or per-object binding is registered
+*/
+static bool php_rayaop_has_bindings(void) {
+    return (RAYAOP_G(intercept_ht) && zend_hash_num_elements(RAYAOP_G(intercept_ht)) > 0) ||
+           (RAYAOP_G(instance_methods) && zend_hash_num_elements(RAYAOP_G(instance_methods)) > 0) ||
+           (RAYAOP_G(persistent_ht) && zend_hash_num_elements(RAYAOP_G(persistent_ht)) > 0) ||
+           (RAYAOP_G(matchers) && zend_hash_num_elements(RAYAOP_G(matchers)) > 0);
+}
+/* }}} */
+
+#ifndef ZTS
+/* {{{ proto bool php_rayaop_swap_hooks(bool active)
+   Function to install or remove the execution hooks (rayaop.lazy, non-thread-safe builds)
+
+   @param bool active Whether the hooks are installed
+   @return bool Returns true if the hooks were swapped, false if another extension wrapped them
+*/
+static bool php_rayaop_swap_hooks(bool active) {
+    if (php_rayaop_backend == PHP_RAYAOP_BACKEND_EXECUTE_EX) {
+        if (zend_execute_ex != (active ? php_rayaop_original_execute_ex : php_rayaop_execute_ex)) {
+            return false; /* Wrapped by another extension */
+        }
+    }
+    if (RAYAOP_G(intercept_internal)) {
+        if (zend_execute_internal != (active ? php_rayaop_original_execute_internal : php_rayaop_execute_internal)) {
+            return false; /* Wrapped by another extension */
+        }
+        zend_execute_internal = active ? php_rayaop_execute_internal : php_rayaop_original_execute_internal;
+    }
+    if (php_rayaop_backend == PHP_RAYAOP_BACKEND_EXECUTE_EX) {
+        zend_execute_ex = active ? php_rayaop_execute_ex : php_rayaop_original_execute_ex;
+    }
+    php_rayaop_hooks_installed = active;
+    return true;
+}
+/* }}} */
+#endif
+
+/* {{{ proto void php_rayaop_update_hooks(void)
+   Function to install or remove the execution hooks (rayaop.lazy)
+
+   With rayaop.lazy (off by default) the hooks are only installed while interception is enabled
+   and something is registered. Otherwise they stay installed, and idle requests only pay for the
+   checks in php_rayaop_should_intercept() and the cached lookup. Swapping the engine
+   pointers is only safe when one request owns the process, so ZTS builds keep the hooks installed
+   and rely on the checks in php_rayaop_should_intercept(). A hook wrapped by an extension loaded
+   after this one is left in place as well.
+*/
+void php_rayaop_update_hooks(void) {
+#ifndef ZTS
+    if (!RAYAOP_G(lazy)) {
+        return; /* Hooks stay installed for the lifetime of the process */
+    }
+    bool active = RAYAOP_G(enabled) && php_rayaop_has_bindings(); /* Whether the hooks are needed */
+    if (active == php_rayaop_hooks_installed) {
+        return;
+    }
+
+    if (php_rayaop_swap_hooks(active)) {
+        PHP_RAYAOP_DEBUG_PRINT("Execution hooks %s", active ? "installed" : "removed"); /* Output debug information */
+    }
+#endif
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_changed(void)
+   Function to invalidate cached lookups after a change of the request registry
+
+   Inside a batch the change is only recorded, so that registering many bindings bumps the
+   registry generation once instead of once per binding.
+*/
+void php_rayaop_registry_changed(void) {
+    if (RAYAOP_G(batch_depth) > 0) {
+        RAYAOP_G(batch_changed) = 1; /* Handled by php_rayaop_batch_end() */
+        return;
+    }
+    RAYAOP_G(generation)++; /* Invalidate cached lookups */
+    php_rayaop_update_hooks(); /* Install or remove the hooks with the first or last binding */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_batch_begin(void)
+   Function to start a batch of registry changes (see php_rayaop_batch_end())
+*/
+void php_rayaop_batch_begin(void) {
+    if (RAYAOP_G(batch_depth)++ == 0) {
+        RAYAOP_G(batch_changed) = 0;
+    }
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_batch_end(bool invalidate)
+   Function to end a batch of registry changes
+
+   Bindings added while resolving a lookup (matchers applied on the first lookup of a class,
+   persistent bindings materialized on the first lookup of a method) pass invalidate = false:
+   no lookup of the current generation has seen the methods they bind. A nested batch leaves
+   the decision to the outermost one.
+
+   @param bool invalidate Whether cached lookups have to be invalidated if the registry changed
+*/
+void php_rayaop_batch_end(bool invalidate) {
+    if (--RAYAOP_G(batch_depth) > 0 || !RAYAOP_G(batch_changed)) {
+        return; /* Nested, or nothing registered */
+    }
+    RAYAOP_G(batch_changed) = 0;
+    if (invalidate) {
+        RAYAOP_G(generation)++; /* Invalidate cached lookups once for the whole batch */
+    }
+    php_rayaop_update_hooks(); /* Install the hooks on the first binding */
+}
+/* }}} */
+
+#ifndef ZTS
+/* {{{ proto zend_op_array* php_rayaop_compile_file(zend_file_handle *file_handle, int type)
+   Compiler hook keeping code compiled while the execution hooks are removed interceptable (rayaop.lazy)
+
+   The compiler picks the call opcode by looking at the installed hooks: without them, calls of
+   functions that are not known yet compile to ZEND_DO_FCALL_BY_NAME and internal function calls
+   to ZEND_DO_ICALL, which never reach zend_execute_ex or zend_execute_internal. The hooks are
+   therefore installed for the duration of the compilation.
+
+   @param zend_file_handle *file_handle The file to compile
+   @param int type The include type
+   @return zend_op_array* The compiled script
+*/
+static zend_op_array *php_rayaop_compile_file(zend_file_handle *file_handle, int type) {
+    if (php_rayaop_hooks_installed || !php_rayaop_swap_hooks(true)) {
+        return php_rayaop_original_compile_file(file_handle, type);
+    }
+
+    zend_op_array *op_array = NULL;
+    bool bailout = false;
+    zend_try {
+        op_array = php_rayaop_original_compile_file(file_handle, type);
+    } zend_catch {
+        bailout = true; /* Fatal error while compiling */
+    } zend_end_try();
+    php_rayaop_update_hooks(); /* Remove the hooks again unless a binding was registered meanwhile (by an error handler) */
+    if (bailout) {
+        zend_bailout();
+    }
+    return op_array;
+}
+/* }}} */
+
+/* {{{ proto zend_op_array* php_rayaop_compile_string(zend_string *source_string, const char *filename)
+   Compiler hook for eval()'d code (see php_rayaop_compile_file())
+*/
+#if PHP_VERSION_ID >= 80200
+static zend_op_array *php_rayaop_compile_string(zend_string *source_string, const char *filename, zend_compile_position position) {
+#define PHP_RAYAOP_COMPILE_STRING_ARGS source_string, filename, position
+#else
+static zend_op_array *php_rayaop_compile_string(zend_string *source_string, const char *filename) {
+#define PHP_RAYAOP_COMPILE_STRING_ARGS source_string, filename
+#endif
+    if (php_rayaop_hooks_installed || !php_rayaop_swap_hooks(true)) {
+        return php_rayaop_original_compile_string(PHP_RAYAOP_COMPILE_STRING_ARGS);
+    }
+
+    zend_op_array *op_array = NULL;
+    bool bailout = false;
+    zend_try {
+        op_array = php_rayaop_original_compile_string(PHP_RAYAOP_COMPILE_STRING_ARGS);
+    } zend_catch {
+        bailout = true; /* Fatal error while compiling */
+    } zend_end_try();
+    php_rayaop_update_hooks(); /* Remove the hooks again unless a binding was registered meanwhile */
+    if (bailout) {
+        zend_bailout();
+    }
+    return op_array;
+}
+#undef PHP_RAYAOP_COMPILE_STRING_ARGS
+/* }}} */
+#endif
+
+/* {{{ proto void php_rayaop_hash_update_failed(php_rayaop_intercept_info *new_info, zend_string *key)
+   Handling for hash table update failure
+
+   This function handles the case when updating the intercept hash table fails.
+
+   @param php_rayaop_intercept_info *new_info The new intercept information that failed to be added
+   @param zend_string *key The key that was used for the failed update
+*/
+void php_rayaop_hash_update_failed(php_rayaop_intercept_info *new_info, zend_string *key) {
+    php_rayaop_handle_error("Failed to update intercept hash table"); /* Output error message */
+    php_rayaop_release_intercept_info(new_info); /* Free intercept information */
+    zend_string_release(key); /* Free memory for key */
+}
+/* }}} */
+
+/* {{{ proto zend_string* php_rayaop_binding_string(const char *str, size_t len)
+   Function to create the class or method name of a new binding
+
+   Names of declared classes and methods are interned already, so the existing string is shared
+   instead of copied.
+
+   @param const char *str The name
+   @param size_t len The length of the name
+   @return zend_string* The interned name if it exists, a new string otherwise
+*/
+static zend_string *php_rayaop_binding_string(const char *str, size_t len) {
+    return zend_string_init_existing_interned(str, len, 0);
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_copy_handler(php_rayaop_handler *handler, const php_rayaop_handler *source)
+   Function to initialize one interceptor of a chain from another entry
+
+   @param php_rayaop_handler *handler The chain entry
+   @param const php_rayaop_handler *source The entry to copy (a new reference to its object is taken)
+*/
+static void php_rayaop_copy_handler(php_rayaop_handler *handler, const php_rayaop_handler *source) {
+    memcpy(handler, source, sizeof(php_rayaop_handler)); /* The resolved method is kept */
+    Z_TRY_ADDREF(handler->object); /* Copy intercept handler */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_handler_equals(const php_rayaop_handler *a, const php_rayaop_handler *b)
+   Function to compare interceptors by identity (method_intercept_remove())
+
+   @return bool Returns true if both entries hold the same object, or the same advice and user pointer
+*/
+static bool php_rayaop_handler_equals(const php_rayaop_handler *a, const php_rayaop_handler *b) {
+    if (a->advice || b->advice) {
+        return a->advice == b->advice && a->advice_data == b->advice_data;
+    }
+    return Z_OBJ(a->object) == Z_OBJ(b->object);
+}
+/* }}} */
+
+/* {{{ proto uint32_t php_rayaop_find_handler(const php_rayaop_intercept_info *info, const php_rayaop_handler *handler)
+   Function to find an interceptor in a chain
+
+   @param const php_rayaop_intercept_info *info The chain (NULL for none)
+   @param const php_rayaop_handler *handler The interceptor (compared by identity)
+   @return uint32_t The position of the interceptor, or the length of the chain if it is not bound
+*/
+static uint32_t php_rayaop_find_handler(const php_rayaop_intercept_info *info, const php_rayaop_handler *handler) {
+    uint32_t count = info ? info->handler_count : 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (php_rayaop_handler_equals(&info->handlers[i], handler)) {
+            return i;
+        }
+    }
+    return count;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_build_chain(php_rayaop_intercept_info *old_info, uint32_t old_count, zend_string *class_name, zend_string *method_name, const php_rayaop_handler *handler, int mode, uint32_t skip)
+   Function to build the chain replacing another one
+
+   @param php_rayaop_intercept_info *old_info The current chain (NULL for none)
+   @param uint32_t old_count The number of interceptors of the current chain that are kept (0 to replace it)
+   @param zend_string *class_name The name of the class
+   @param zend_string *method_name The name of the method
+   @param const php_rayaop_handler *handler The interceptor to add (copied)
+   @param int mode PHP_RAYAOP_CHAIN_REPLACE, PHP_RAYAOP_CHAIN_APPEND, PHP_RAYAOP_CHAIN_PREPEND or PHP_RAYAOP_CHAIN_REMOVE
+   @param uint32_t skip The position of the removed interceptor (PHP_RAYAOP_CHAIN_REMOVE)
+   @return php_rayaop_intercept_info* The new chain with a reference count of 1
+*/
+static php_rayaop_intercept_info *php_rayaop_build_chain(php_rayaop_intercept_info *old_info, uint32_t old_count, zend_string *class_name, zend_string *method_name, const php_rayaop_handler *handler, int mode, uint32_t skip) {
+    uint32_t new_count = (mode == PHP_RAYAOP_CHAIN_REMOVE) ? old_count - 1 : old_count + 1; /* Length of the new chain */
+    php_rayaop_intercept_info *new_info = php_rayaop_alloc_intercept_info(class_name, method_name, new_count);
+
+    if (old_info) {
+        new_info->sample_rate = old_info->sample_rate; /* The sampling rate belongs to the method, not to the chain */
+    }
+
+    php_rayaop_handler *next = new_info->handlers; /* Next entry to fill in */
+    if (mode == PHP_RAYAOP_CHAIN_PREPEND) {
+        php_rayaop_copy_handler(next++, handler);
+    }
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (mode != PHP_RAYAOP_CHAIN_REMOVE || i != skip) {
+            php_rayaop_copy_handler(next++, &old_info->handlers[i]); /* Keep existing interceptor */
+        }
+    }
+    if (mode == PHP_RAYAOP_CHAIN_REPLACE || mode == PHP_RAYAOP_CHAIN_APPEND) {
+        php_rayaop_copy_handler(next++, handler);
+    }
+    return new_info;
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_register_handler(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const php_rayaop_handler *handler, int mode)
+   Function to register intercept information in the request registry
+
+   Bindings are never changed in place: a new chain is built and replaces the old one, so
+   invocations that are walking the old chain are not affected. The key is looked up from a stack
+   buffer; it is interned and stored only when the method is bound for the first time, and a
+   replaced chain keeps the stored key.
+
+   @param const char *class_name The name of the class
+   @param size_t class_name_len The length of the class name
+   @param const char *method_name The name of the method
+   @param size_t method_name_len The length of the method name
+   @param const php_rayaop_handler *handler The interceptor to add or remove (copied)
+   @param int mode PHP_RAYAOP_CHAIN_REPLACE, PHP_RAYAOP_CHAIN_APPEND, PHP_RAYAOP_CHAIN_PREPEND or PHP_RAYAOP_CHAIN_REMOVE
+   @return bool Returns true on success or false on failure (removing an interceptor that is not bound)
+*/
+static bool php_rayaop_register_handler(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const php_rayaop_handler *handler, int mode) {
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, class_name, class_name_len, method_name, method_name_len, &key_len);
+    zval *entry = zend_hash_str_find(RAYAOP_G(intercept_ht), key, key_len); /* Registry entry of the method */
+    php_rayaop_intercept_info *old_info = entry ? Z_PTR_P(entry) : NULL; /* Current chain */
+    uint32_t old_count = (old_info && mode != PHP_RAYAOP_CHAIN_REPLACE) ? old_info->handler_count : 0; /* Interceptors kept */
+    uint32_t skip = old_count; /* Position of the removed interceptor */
+
+    if (mode == PHP_RAYAOP_CHAIN_REMOVE) {
+        skip = php_rayaop_find_handler(old_info, handler);
+        if (skip == old_count) {
+            PHP_RAYAOP_RELEASE_KEY(key, buf);
+            return false; /* Not bound */
+        }
+        if (old_count == 1) {
+            zend_hash_str_del(RAYAOP_G(intercept_ht), key, key_len); /* Last interceptor removed */
+            php_rayaop_unmark_class(class_name, class_name_len);
+            PHP_RAYAOP_RELEASE_KEY(key, buf);
+            php_rayaop_registry_changed(); /* The registry may have become empty */
+            return true;
+        }
+    }
+
+    zend_string *class_str = old_info ? zend_string_copy(old_info->class_name) : php_rayaop_binding_string(class_name, class_name_len);
+    zend_string *method_str = old_info ? zend_string_copy(old_info->method_name) : php_rayaop_binding_string(method_name, method_name_len);
+    php_rayaop_intercept_info *new_info = php_rayaop_build_chain(old_info, old_count, class_str, method_str, handler, mode, skip);
+    zend_string_release(class_str);
+    zend_string_release(method_str);
+
+    if (entry) {
+        Z_PTR_P(entry) = new_info; /* Replace the chain under the stored key */
+        php_rayaop_release_intercept_info(old_info);
+    } else {
+        zend_string *stored_key = zend_string_init_interned(key, key_len, 0); /* Interned key (shared by every request with opcache) */
+        if (zend_hash_add_new_ptr(RAYAOP_G(intercept_ht), stored_key, new_info) == NULL) {
+            /* Add to hash table */
+            php_rayaop_hash_update_failed(new_info, stored_key); /* Execute error handling if addition fails */
+            PHP_RAYAOP_RELEASE_KEY(key, buf);
+            return false;
+        }
+        zend_string_release(stored_key); /* The registry holds its own reference */
+        php_rayaop_mark_class(class_name, class_name_len); /* Mark the class as having interceptors */
+        php_rayaop_observer_attach_name(class_name, class_name_len, method_name, method_name_len); /* Already called in this request */
+    }
+
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    php_rayaop_registry_changed(); /* Install the hooks on the first binding */
+    return true;
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_register_intercept(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, zval *handler, int mode)
+   Function to register an interceptor object in the request registry
+
+   @param const char *class_name The name of the class
+   @param size_t class_name_len The length of the class name
+   @param const char *method_name The name of the method
+   @param size_t method_name_len The length of the method name
+   @param zval *handler The interceptor object (a new reference is taken)
+   @param int mode PHP_RAYAOP_CHAIN_REPLACE, PHP_RAYAOP_CHAIN_APPEND, PHP_RAYAOP_CHAIN_PREPEND or PHP_RAYAOP_CHAIN_REMOVE
+   @return bool Returns true on success or false on failure (removing an interceptor that is not bound)
+*/
+bool php_rayaop_register_intercept(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, zval *handler, int mode) {
+    php_rayaop_handler entry; /* Borrows the object; copies take their own reference */
+    ZVAL_COPY_VALUE(&entry.object, handler);
+    entry.native = php_rayaop_prepare_handler_fcc(handler, &entry.fcc); /* Resolve the interceptor method once */
+    entry.advice = NULL;
+    entry.advice_data = NULL;
+    return php_rayaop_register_handler(class_name, class_name_len, method_name, method_name_len, &entry, mode);
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_register_advice(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const php_rayaop_advice *advice, void *user_data, int mode)
+   Function to register native advice of another extension
+
+   The advice becomes an entry of the interceptor chain of the method, so it composes with PHP
+   interceptors registered through method_intercept*(). Like those, it is registered for the
+   current request: call it from RINIT (declare a ZEND_MOD_REQUIRED dependency on "rayaop" so
+   this extension's RINIT runs first) or at any later point of the request.
+
+   @param const char *class_name The name of the class
+   @param size_t class_name_len The length of the class name
+   @param const char *method_name The name of the method
+   @param size_t method_name_len The length of the method name
+   @param const php_rayaop_advice *advice The callbacks (must stay valid while registered, usually static)
+   @param void *user_data User pointer passed to the callbacks (owned by the caller)
+   @param int mode PHP_RAYAOP_CHAIN_REPLACE, PHP_RAYAOP_CHAIN_APPEND, PHP_RAYAOP_CHAIN_PREPEND or PHP_RAYAOP_CHAIN_REMOVE
+   @return bool Returns true on success, false outside a request or when removing advice that is not bound
+*/
+PHP_RAYAOP_API bool php_rayaop_register_advice(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const php_rayaop_advice *advice, void *user_data, int mode) {
+    if (!RAYAOP_G(intercept_ht) || !advice) {
+        return false; /* The registry only exists during a request */
+    }
+
+    php_rayaop_handler entry;
+    ZVAL_UNDEF(&entry.object);
+    memset(&entry.fcc, 0, sizeof(zend_fcall_info_cache));
+    entry.native = true; /* Never proceeds by calling the method by name */
+    entry.advice = advice;
+    entry.advice_data = user_data;
+    return php_rayaop_register_handler(class_name, class_name_len, method_name, method_name_len, &entry, mode);
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAMETERS, int mode)
+   Shared implementation of method_intercept(), method_intercept_append(), method_intercept_prepend() and method_intercept_remove()
+
+   @param int mode The chain operation
+*/
+static void php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAMETERS, int mode) {
+    char *class_name, *method_name; /* Pointers for class name and method name */
+    size_t class_name_len, method_name_len; /* Lengths of class name and method name */
+    zval *intercepted; /* Intercept handler */
+
+    ZEND_PARSE_PARAMETERS_START(3, 3)
+        Z_PARAM_STRING(class_name, class_name_len) /* Parse class name parameter */
+        Z_PARAM_STRING(method_name, method_name_len) /* Parse method name parameter */
+        Z_PARAM_OBJECT(intercepted) /* Parse intercept handler parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!php_rayaop_register_intercept(class_name, class_name_len, method_name, method_name_len, intercepted, mode)) {
+        RETURN_FALSE; /* Return false and end */
+    }
+
+    PHP_RAYAOP_DEBUG_PRINT("Successfully registered intercept info"); /* Output debug information */
+    RETURN_TRUE; /* Return true and end */
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept(string class_name, string method_name, object intercepted)
+   Function to register intercept method
+
+   This function registers an interceptor for a specified class method, replacing any interceptors
+   registered before.
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_intercept) {
+    PHP_RAYAOP_DEBUG_PRINT("method_intercept called"); /* Output debug information */
+    php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_REPLACE);
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_append(string class_name, string method_name, object intercepted)
+   Function to add an interceptor to the end of the chain of a method (it runs innermost)
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_intercept_append) {
+    php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_APPEND);
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_prepend(string class_name, string method_name, object intercepted)
+   Function to add an interceptor to the start of the chain of a method (it runs outermost)
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_intercept_prepend) {
+    php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_PREPEND);
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_remove(string class_name, string method_name, object intercepted)
+   Function to remove an interceptor from the chain of a method
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object (compared by identity)
+   @return bool Returns TRUE if the interceptor was removed, FALSE if it was not bound to the method
+*/
+PHP_FUNCTION(method_intercept_remove) {
+    php_rayaop_intercept_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_REMOVE);
+}
+/* }}} */
+
+/* {{{ proto bool function_intercept(string function_name, object intercepted)
+   Function to register an interceptor for a function
+
+   Functions are bound under the empty class name, so method_intercept_append(),
+   method_intercept_prepend() and method_intercept_remove() change their chains with '' as the
+   class name. Classic interceptors receive null instead of an object.
+
+   @param string function_name The name of the function (with its namespace)
+   @param object intercepted The interceptor object
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(function_intercept) {
+    char *function_name; /* Function name */
+    size_t function_name_len; /* Length of function name */
+    zval *intercepted; /* Intercept handler */
+
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_STRING(function_name, function_name_len) /* Parse function name parameter */
+        Z_PARAM_OBJECT(intercepted) /* Parse intercept handler parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (function_name_len > 0 && function_name[0] == '\\') {
+        function_name++; /* Fully qualified name */
+        function_name_len--;
+    }
+    RETURN_BOOL(php_rayaop_register_intercept("", 0, function_name, function_name_len, intercepted, PHP_RAYAOP_CHAIN_REPLACE));
+}
+/* }}} */
+
+/* {{{ proto zval* php_rayaop_binding_entry(zval *binding, zend_ulong index, uint8_t type)
+   Function to fetch one element of a [class name, method name, interceptor] list
+
+   @param zval *binding The list
+   @param zend_ulong index The position of the element
+   @param uint8_t type The expected type
+   @return zval* The element, or NULL if it is missing or of another type
+*/
+static zval *php_rayaop_binding_entry(zval *binding, zend_ulong index, uint8_t type) {
+    zval *entry = zend_hash_index_find(Z_ARRVAL_P(binding), index);
+    if (!entry) {
+        return NULL; /* Missing element */
+    }
+    ZVAL_DEREF(entry);
+    return Z_TYPE_P(entry) == type ? entry : NULL;
+}
+/* }}} */
+
+/* {{{ proto int method_intercept_many(array bindings)
+   Function to register many interceptors at once
+
+   Each element is a [class_name, method_name, interceptor] list, and each interceptor is added
+   to the end of the chain of its method as with method_intercept_append(). The registry is
+   grown once for the whole batch instead of rehashing while the bindings are added, and cached
+   lookups are invalidated once instead of once per binding, so this is the preferred way to register the bindings of a large application. The list is validated
+   before anything is registered.
+
+   @param array bindings The bindings to register
+   @return int The number of registered interceptors
+*/
+PHP_FUNCTION(method_intercept_many) {
+    HashTable *bindings;
+    zval *binding;
+    zend_long registered = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY_HT(bindings) /* Parse bindings parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    ZEND_HASH_FOREACH_VAL(bindings, binding) {
+        ZVAL_DEREF(binding);
+        if (Z_TYPE_P(binding) != IS_ARRAY ||
+            !php_rayaop_binding_entry(binding, 0, IS_STRING) ||
+            !php_rayaop_binding_entry(binding, 1, IS_STRING) ||
+            !php_rayaop_binding_entry(binding, 2, IS_OBJECT)) {
+            zend_argument_type_error(1, "must contain only [string $class_name, string $method_name, object $interceptor] lists");
+            RETURN_THROWS();
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    zend_hash_extend(RAYAOP_G(intercept_ht), zend_hash_num_elements(RAYAOP_G(intercept_ht)) + zend_hash_num_elements(bindings), 0); /* Grow once */
+
+    php_rayaop_batch_begin(); /* Invalidate cached lookups once */
+    ZEND_HASH_FOREACH_VAL(bindings, binding) {
+        ZVAL_DEREF(binding);
+        zval *class_name = php_rayaop_binding_entry(binding, 0, IS_STRING);
+        zval *method_name = php_rayaop_binding_entry(binding, 1, IS_STRING);
+        if (php_rayaop_register_intercept(Z_STRVAL_P(class_name), Z_STRLEN_P(class_name), Z_STRVAL_P(method_name), Z_STRLEN_P(method_name),
+                                          php_rayaop_binding_entry(binding, 2, IS_OBJECT), PHP_RAYAOP_CHAIN_APPEND)) {
+            registered++;
+        }
+    } ZEND_HASH_FOREACH_END();
+    php_rayaop_batch_end(true);
+
+    RETURN_LONG(registered); /* Return the number of registered interceptors */
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_sample(string class_name, string method_name, int rate)
+   Function to intercept only a random sample of the calls of a method
+
+   On average one in rate outermost calls runs the interceptor chain; the others go straight to
+   the original method before any argument is copied, so tracing advice can stay enabled at a
+   fixed cost. The rate applies to the method until its last interceptor is removed, whatever
+   interceptors are added or replaced meanwhile. A rate of 1 intercepts every call again.
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param int rate One in rate calls is intercepted
+   @return bool Returns TRUE on success or FALSE if the method has no interceptor
+*/
+PHP_FUNCTION(method_intercept_sample) {
+    char *class_name, *method_name; /* Class name and method name */
+    size_t class_name_len, method_name_len; /* Length of class name and method name */
+    zend_long rate; /* Sampling rate */
+
+    ZEND_PARSE_PARAMETERS_START(3, 3)
+        Z_PARAM_STRING(class_name, class_name_len) /* Parse class name parameter */
+        Z_PARAM_STRING(method_name, method_name_len) /* Parse method name parameter */
+        Z_PARAM_LONG(rate) /* Parse rate parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (rate < 1 || (zend_ulong) rate > UINT32_MAX) {
+        zend_argument_value_error(3, "must be between 1 and %" PRIu32, UINT32_MAX);
+        RETURN_THROWS();
+    }
+
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, class_name, class_name_len, method_name, method_name_len, &key_len);
+    php_rayaop_intercept_info *info = php_rayaop_find_intercept_info(key, key_len); /* Current chain */
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    if (!info) {
+        RETURN_FALSE; /* Not bound */
+    }
+
+    info->sample_rate = (uint32_t) rate; /* Read on every call, so cached lookups stay valid */
+    RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_count_instance_method(zend_string *key, zend_string *class_name, bool bound)
+   Function to count the objects that have their own interceptors for a method
+
+   The first object bound for a method marks its class and invalidates cached lookups, so that
+   calls of the method check the called object; releasing the last one drops the mark again.
+
+   @param zend_string *key The intercept key ("class::method")
+   @param zend_string *class_name The name of the class
+   @param bool bound Whether an object was bound (true) or released (false)
+*/
+static void php_rayaop_count_instance_method(zend_string *key, zend_string *class_name, bool bound) {
+    if (!RAYAOP_G(instance_methods)) {
+        return; /* Outside of a request */
+    }
+
+    zval *count = zend_hash_find(RAYAOP_G(instance_methods), key); /* Number of bound objects */
+    if (bound) {
+        if (count) {
+            Z_LVAL_P(count)++; /* One more object */
+            return;
+        }
+        zval one;
+        ZVAL_LONG(&one, 1);
+        zend_hash_add_new(RAYAOP_G(instance_methods), key, &one); /* First object */
+        php_rayaop_mark_class(ZSTR_VAL(class_name), ZSTR_LEN(class_name));
+    } else {
+        if (!count || --Z_LVAL_P(count) > 0) {
+            return; /* Other objects are still bound */
+        }
+        zend_hash_del(RAYAOP_G(instance_methods), key); /* Last object released */
+        php_rayaop_unmark_class(ZSTR_VAL(class_name), ZSTR_LEN(class_name));
+    }
+    php_rayaop_registry_changed(); /* Install the hooks on the first binding */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_free_instance_binding(zval *zv)
+   Function to free the interceptors bound to one method of an object
+
+   @param zval *zv The zval containing the binding to be freed
+*/
+static void php_rayaop_free_instance_binding(zval *zv) {
+    php_rayaop_instance_binding *binding = Z_PTR_P(zv);
+    php_rayaop_count_instance_method(binding->key, binding->own->class_name, false);
+    php_rayaop_release_intercept_info(binding->own);
+    if (binding->combined) {
+        php_rayaop_release_intercept_info(binding->combined);
+    }
+    if (binding->base) {
+        php_rayaop_release_intercept_info(binding->base);
+    }
+    zend_string_release(binding->key); /* Free memory for key */
+    efree(binding);
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_free_instance_bindings(zend_resource *res)
+   Resource destructor of the binding table of an object (run when the object is freed)
+
+   @param zend_resource *res The resource holding the table
+*/
+static void php_rayaop_free_instance_bindings(zend_resource *res) {
+    HashTable *bindings = res->ptr;
+    zend_hash_destroy(bindings); /* Releases the bindings of every method */
+    FREE_HASHTABLE(bindings);
+}
+/* }}} */
+
+/* {{{ proto HashTable* php_rayaop_instance_bindings(zend_object *object, bool create)
+   Function to get the binding table of an object
+
+   Tables live in a WeakMap keyed by the object, so they are released together with the object
+   without holding a reference to it.
+
+   @param zend_object *object The object
+   @param bool create Whether the table is created if the object has none
+   @return HashTable* The bindings by zend_function pointer, or NULL if the object has none
+*/
+static HashTable *php_rayaop_instance_bindings(zend_object *object, bool create) {
+    zval *map = &RAYAOP_G(instances); /* WeakMap of the current request */
+    zval key, rv;
+
+    if (Z_TYPE_P(map) != IS_OBJECT) {
+        if (!create) {
+            return NULL; /* No object was bound yet */
+        }
+        object_init_ex(map, php_rayaop_weakmap_ce); /* Destroyed at request shutdown */
+    }
+
+    ZVAL_OBJ(&key, object);
+    zval *entry = Z_OBJ_HT_P(map)->read_dimension(Z_OBJ_P(map), &key, BP_VAR_IS, &rv); /* Points into the map */
+    if (entry && Z_TYPE_P(entry) == IS_RESOURCE) {
+        return Z_RES_VAL_P(entry);
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    HashTable *bindings;
+    ALLOC_HASHTABLE(bindings); /* Freed with the resource */
+    zend_hash_init(bindings, 4, NULL, php_rayaop_free_instance_binding, 0);
+    zval value;
+    ZVAL_RES(&value, zend_register_resource(bindings, php_rayaop_le_instance_bindings));
+    Z_OBJ_HT_P(map)->write_dimension(Z_OBJ_P(map), &key, &value); /* The map takes its own reference */
+    zval_ptr_dtor(&value);
+    return bindings;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_instance_intercept_info(zend_execute_data *execute_data, php_rayaop_intercept_info *info)
+   Function to add the interceptors bound to the called object to the chain of a method
+
+   Only reached for methods bound on at least one object. Objects that are not weakly referenced
+   cannot be in the map and are rejected on a flag test. The interceptors of the object run before
+   the class-level chain; the combined chain is built once and reused until either part changes.
+
+   @param zend_execute_data *execute_data The execution data of the call
+   @param php_rayaop_intercept_info *info The class-level intercept information (NULL for none)
+   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_instance_intercept_info(zend_execute_data *execute_data, php_rayaop_intercept_info *info) {
+    if (Z_TYPE(execute_data->This) != IS_OBJECT || !(GC_FLAGS(Z_OBJ(execute_data->This)) & IS_OBJ_WEAKLY_REFERENCED)) {
+        return info; /* Not bound on the object */
+    }
+
+    HashTable *bindings = php_rayaop_instance_bindings(Z_OBJ(execute_data->This), false);
+    php_rayaop_instance_binding *binding = bindings ? zend_hash_index_find_ptr(bindings, (zend_ulong) (uintptr_t) execute_data->func) : NULL;
+    if (!binding) {
+        return info; /* The object has no interceptors for this method */
+    }
+    if (!info) {
+        return binding->own; /* No class-level chain */
+    }
+
+    if (!binding->combined || binding->base != info) {
+        /* First call, or one of the chains changed (the reference on base keeps its address from being reused) */
+        php_rayaop_intercept_info *own = binding->own;
+        php_rayaop_intercept_info *combined = php_rayaop_alloc_intercept_info(own->class_name, own->method_name, own->handler_count + info->handler_count);
+        for (uint32_t i = 0; i < own->handler_count; i++) {
+            php_rayaop_copy_handler(&combined->handlers[i], &own->handlers[i]);
+        }
+        for (uint32_t i = 0; i < info->handler_count; i++) {
+            php_rayaop_copy_handler(&combined->handlers[own->handler_count + i], &info->handlers[i]);
+        }
+        info->refcount++; /* Held while combined is built from it (taken first: base may be info) */
+        if (binding->combined) {
+            php_rayaop_release_intercept_info(binding->combined);
+        }
+        if (binding->base) {
+            php_rayaop_release_intercept_info(binding->base);
+        }
+        binding->base = info;
+        binding->combined = combined;
+    }
+    return binding->combined;
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_register_instance(zend_object *object, zend_function *func, const php_rayaop_handler *handler, int mode)
+   Function to change the interceptors bound to one method of an object
+
+   @param zend_object *object The object
+   @param zend_function *func The method, as found in the function table of the object's class
+   @param const php_rayaop_handler *handler The interceptor to add or remove (copied)
+   @param int mode PHP_RAYAOP_CHAIN_APPEND or PHP_RAYAOP_CHAIN_REMOVE
+   @return bool Returns true on success or false on failure (removing an interceptor that is not bound)
+*/
+static bool php_rayaop_register_instance(zend_object *object, zend_function *func, const php_rayaop_handler *handler, int mode) {
+    HashTable *bindings = php_rayaop_instance_bindings(object, mode != PHP_RAYAOP_CHAIN_REMOVE);
+    zend_ulong index = (zend_ulong) (uintptr_t) func; /* Calls are matched by the executed function */
+    php_rayaop_instance_binding *binding = bindings ? zend_hash_index_find_ptr(bindings, index) : NULL;
+    php_rayaop_intercept_info *own = binding ? binding->own : NULL; /* Current chain of the object */
+    uint32_t skip = 0; /* Position of the removed interceptor */
+
+    if (mode == PHP_RAYAOP_CHAIN_REMOVE) {
+        skip = php_rayaop_find_handler(own, handler);
+        if (!own || skip == own->handler_count) {
+            return false; /* Not bound */
+        }
+        if (own->handler_count == 1) {
+            zend_hash_index_del(bindings, index); /* Last interceptor removed */
+            if (zend_hash_num_elements(bindings) == 0) {
+                zval *map = &RAYAOP_G(instances);
+                zval key;
+                ZVAL_OBJ(&key, object);
+                Z_OBJ_HT_P(map)->unset_dimension(Z_OBJ_P(map), &key); /* The object is no longer weakly referenced */
+            }
+            return true;
+        }
+    }
+
+    php_rayaop_observer_attach(func); /* Already called in this request */
+    php_rayaop_intercept_info *new_own = php_rayaop_build_chain(own, own ? own->handler_count : 0, func->common.scope->name, func->common.function_name, handler, mode, skip);
+    if (binding) {
+        php_rayaop_release_intercept_info(own);
+        binding->own = new_own;
+        if (binding->combined) {
+            php_rayaop_release_intercept_info(binding->combined); /* Rebuilt on the next call */
+            binding->combined = NULL;
+        }
+        return true;
+    }
+
+    binding = emalloc(sizeof(php_rayaop_instance_binding)); /* Freed with the binding table */
+    binding->own = new_own;
+    binding->combined = NULL;
+    binding->base = NULL;
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, ZSTR_VAL(func->common.scope->name), ZSTR_LEN(func->common.scope->name),
+        ZSTR_VAL(func->common.function_name), ZSTR_LEN(func->common.function_name), &key_len);
+    binding->key = zend_string_init_interned(key, key_len, 0); /* Same key as the registry */
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    zend_hash_index_add_new_ptr(bindings, index, binding);
+    php_rayaop_count_instance_method(binding->key, new_own->class_name, true);
+    return true;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_intercept_object_function(INTERNAL_FUNCTION_PARAMETERS, int mode)
+   Shared implementation of method_intercept_object() and method_intercept_object_remove()
+
+   @param int mode The chain operation
+*/
+static void php_rayaop_intercept_object_function(INTERNAL_FUNCTION_PARAMETERS, int mode) {
+    zval *object; /* Object to bind */
+    zend_string *method_name; /* Method name */
+    zval *intercepted; /* Intercept handler */
+
+    ZEND_PARSE_PARAMETERS_START(3, 3)
+        Z_PARAM_OBJECT(object) /* Parse object parameter */
+        Z_PARAM_STR(method_name) /* Parse method name parameter */
+        Z_PARAM_OBJECT(intercepted) /* Parse intercept handler parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    zend_class_entry *ce = Z_OBJCE_P(object);
+    zend_string *lc_name = zend_string_tolower(method_name);
+    zend_function *func = zend_hash_find_ptr(&ce->function_table, lc_name); /* Method as called on the object */
+    zend_string_release(lc_name);
+    if (!func || (func->common.fn_flags & ZEND_ACC_STATIC)) {
+        zend_argument_value_error(2, "must be the name of a non-static method of %s", ZSTR_VAL(ce->name));
+        RETURN_THROWS();
+    }
+
+    php_rayaop_handler entry; /* Borrows the object; copies take their own reference */
+    ZVAL_COPY_VALUE(&entry.object, intercepted);
+    entry.native = php_rayaop_prepare_handler_fcc(intercepted, &entry.fcc); /* Resolve the interceptor method once */
+    entry.advice = NULL;
+    entry.advice_data = NULL;
+    RETURN_BOOL(php_rayaop_register_instance(Z_OBJ_P(object), func, &entry, mode));
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_object(object object, string method_name, object intercepted)
+   Function to add an interceptor to the chain of a method of one object
+
+   The interceptor only runs for calls on this object, before the interceptors bound to the class,
+   and is released when the object is freed. Other objects of the class keep the fast path.
+
+   @param object object The object
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_intercept_object) {
+    php_rayaop_intercept_object_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_APPEND);
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_object_remove(object object, string method_name, object intercepted)
+   Function to remove an interceptor from the chain of a method of one object
+
+   @param object object The object
+   @param string method_name The name of the method
+   @param object intercepted The interceptor object (compared by identity)
+   @return bool Returns TRUE if the interceptor was removed, FALSE if it was not bound to the object
+*/
+PHP_FUNCTION(method_intercept_object_remove) {
+    php_rayaop_intercept_object_function(INTERNAL_FUNCTION_PARAM_PASSTHRU, PHP_RAYAOP_CHAIN_REMOVE);
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_glob_match(const char *pattern, size_t pattern_len, const char *subject, size_t subject_len)
+   Function to match a name against a glob pattern
+
+   "*" matches any sequence (including namespace separators, so "App\Service\*" is a namespace
+   prefix) and "?" matches a single character. Matching is case-insensitive like PHP names.
+
+   @param const char *pattern The pattern
+   @param size_t pattern_len The length of the pattern
+   @param const char *subject The class or method name
+   @param size_t subject_len The length of the name
+   @return bool Whether the name matches
+*/
+bool php_rayaop_glob_match(const char *pattern, size_t pattern_len, const char *subject, size_t subject_len) {
+    size_t p = 0, n = 0; /* Positions in pattern and subject */
+    size_t star = (size_t) -1, star_n = 0; /* Last "*" and the subject position it was tried at */
+
+    while (n < subject_len) {
+        if (p < pattern_len && pattern[p] == '*') {
+            star = p++; /* Try an empty match first */
+            star_n = n;
+        } else if (p < pattern_len && (pattern[p] == '?' || zend_tolower_ascii(pattern[p]) == zend_tolower_ascii(subject[n]))) {
+            p++;
+            n++;
+        } else if (star != (size_t) -1) {
+            p = star + 1; /* Let the last "*" consume one more character */
+            n = ++star_n;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern_len && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern_len;
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_matcher_matches(php_rayaop_matcher *matcher, zend_class_entry *ce, zend_function *func)
+   Function to check a matcher against a method
+
+   @param php_rayaop_matcher *matcher The matcher
+   @param zend_class_entry *ce The class declaring the method
+   @param zend_function *func The method
+   @return bool Whether the method matches
+*/
+static bool php_rayaop_matcher_matches(php_rayaop_matcher *matcher, zend_class_entry *ce, zend_function *func) {
+    if (!php_rayaop_glob_match(ZSTR_VAL(matcher->class_pattern), ZSTR_LEN(matcher->class_pattern), ZSTR_VAL(ce->name), ZSTR_LEN(ce->name)) ||
+        !php_rayaop_glob_match(ZSTR_VAL(matcher->method_pattern), ZSTR_LEN(matcher->method_pattern), ZSTR_VAL(func->common.function_name), ZSTR_LEN(func->common.function_name))) {
+        return false;
+    }
+    if (!matcher->attribute) {
+        return true;
+    }
+    return (func->common.attributes && zend_get_attribute(func->common.attributes, matcher->attribute)) ||
+           (ce->attributes && zend_get_attribute(ce->attributes, matcher->attribute)); /* On the method or its class */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_apply_matcher(php_rayaop_matcher *matcher, zend_class_entry *ce)
+   Function to turn a matcher into bindings for the methods declared by a class
+
+   Inherited methods are bound through the class that declares them. Static and abstract methods
+   are skipped.
+
+   @param php_rayaop_matcher *matcher The matcher
+   @param zend_class_entry *ce The class
+*/
+static void php_rayaop_apply_matcher(php_rayaop_matcher *matcher, zend_class_entry *ce) {
+    zend_function *func;
+
+    ZEND_HASH_FOREACH_PTR(&ce->function_table, func) {
+        if (func->common.scope != ce || (func->common.fn_flags & (ZEND_ACC_STATIC | ZEND_ACC_ABSTRACT))) {
+            continue;
+        }
+        if (php_rayaop_matcher_matches(matcher, ce, func)) {
+            PHP_RAYAOP_DEBUG_PRINT("Matched %s::%s", ZSTR_VAL(ce->name), ZSTR_VAL(func->common.function_name)); /* Output debug information */
+            php_rayaop_register_intercept(ZSTR_VAL(ce->name), ZSTR_LEN(ce->name),
+                ZSTR_VAL(func->common.function_name), ZSTR_LEN(func->common.function_name), &matcher->handler, PHP_RAYAOP_CHAIN_APPEND);
+        }
+    } ZEND_HASH_FOREACH_END();
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_apply_matchers(zend_class_entry *ce)
+   Function to evaluate all matchers against a class (once per class and request)
+
+   @param zend_class_entry *ce The class
+*/
+void php_rayaop_apply_matchers(zend_class_entry *ce) {
+    php_rayaop_matcher *matcher;
+
+    zend_hash_add_empty_element(RAYAOP_G(matched_classes), ce->name); /* Never evaluated again */
+    ZEND_HASH_FOREACH_PTR(RAYAOP_G(matchers), matcher) {
+        php_rayaop_apply_matcher(matcher, ce); /* In registration order */
+    } ZEND_HASH_FOREACH_END();
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_free_matcher(zval *zv)
+   Function to free a matcher
+
+   @param zval *zv The zval containing the matcher to be freed
+*/
+static void php_rayaop_free_matcher(zval *zv) {
+    php_rayaop_matcher *matcher = Z_PTR_P(zv); /* Get matcher pointer from zval */
+    zend_string_release(matcher->class_pattern); /* Free memory for class pattern */
+    zend_string_release(matcher->method_pattern); /* Free memory for method pattern */
+    if (matcher->attribute) {
+        zend_string_release(matcher->attribute); /* Free memory for attribute name */
+    }
+    zval_ptr_dtor(&matcher->handler); /* Free memory for handler */
+    efree(matcher); /* Free memory for matcher structure */
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_match(string class_pattern, string method_pattern, object interceptor, ?string attribute = null)
+   Function to register an interceptor for every method matching a pattern
+
+   Matchers are not evaluated against all classes of the project: each class is matched once,
+   when one of its methods is first called, and the matching methods get the interceptor
+   appended to their chains. Classes that were already matched are matched again immediately.
+   With the observer backend, declared classes matching the class pattern are matched
+   immediately too, since their methods may have been observed before any matcher existed.
+
+   @param string class_pattern Glob pattern for the class declaring the method (e.g. "App\Service\*")
+   @param string method_pattern Glob pattern for the method name (e.g. "find*")
+   @param object interceptor The interceptor object
+   @param string|null attribute Attribute class the method or its class must declare (e.g. Transactional::class)
+   @return bool Returns TRUE on success
+*/
+PHP_FUNCTION(method_intercept_match) {
+    zend_string *class_pattern, *method_pattern, *attribute = NULL; /* Patterns and attribute name */
+    zval *interceptor; /* Intercept handler */
+
+    ZEND_PARSE_PARAMETERS_START(3, 4)
+        Z_PARAM_STR(class_pattern) /* Parse class pattern parameter */
+        Z_PARAM_STR(method_pattern) /* Parse method pattern parameter */
+        Z_PARAM_OBJECT(interceptor) /* Parse intercept handler parameter */
+        Z_PARAM_OPTIONAL
+        Z_PARAM_STR_OR_NULL(attribute) /* Parse attribute parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    php_rayaop_matcher *matcher = emalloc(sizeof(php_rayaop_matcher)); /* Allocate matcher */
+    if (ZSTR_LEN(class_pattern) > 0 && ZSTR_VAL(class_pattern)[0] == '\\') {
+        matcher->class_pattern = zend_string_init(ZSTR_VAL(class_pattern) + 1, ZSTR_LEN(class_pattern) - 1, 0); /* Strip the leading separator */
+    } else {
+        matcher->class_pattern = zend_string_copy(class_pattern);
+    }
+    matcher->method_pattern = zend_string_copy(method_pattern);
+    matcher->attribute = NULL;
+    if (attribute) {
+        size_t offset = (ZSTR_LEN(attribute) > 0 && ZSTR_VAL(attribute)[0] == '\\') ? 1 : 0; /* Strip the leading separator */
+        zend_string *name = zend_string_init(ZSTR_VAL(attribute) + offset, ZSTR_LEN(attribute) - offset, 0);
+        matcher->attribute = zend_string_tolower(name); /* Attributes are looked up by lowercase name */
+        zend_string_release(name);
+    }
+    ZVAL_COPY(&matcher->handler, interceptor); /* Copy intercept handler */
+    zend_hash_next_index_insert_ptr(RAYAOP_G(matchers), matcher);
+
+    php_rayaop_batch_begin();
+    php_rayaop_registry_changed(); /* Cached misses of classes not matched yet must be looked up again */
+
+    zend_string *class_name;
+    ZEND_HASH_FOREACH_STR_KEY(RAYAOP_G(matched_classes), class_name) {
+        zend_class_entry *ce = zend_hash_find_ptr_lc(EG(class_table), class_name); /* Already matched class */
+        if (ce) {
+            php_rayaop_apply_matcher(matcher, ce);
+        }
+    } ZEND_HASH_FOREACH_END();
+    if (php_rayaop_backend == PHP_RAYAOP_BACKEND_OBSERVER) {
+        /* Methods called while no matcher existed were observed without matching their class */
+        zend_string *key;
+        zend_class_entry *ce;
+        ZEND_HASH_FOREACH_STR_KEY_PTR(EG(class_table), key, ce) {
+            if (ce->type == ZEND_USER_CLASS && key && ZSTR_VAL(key)[0] != '\0' && /* Not a class declared at run time but not bound yet */
+                !zend_hash_exists(RAYAOP_G(matched_classes), ce->name) &&
+                php_rayaop_glob_match(ZSTR_VAL(matcher->class_pattern), ZSTR_LEN(matcher->class_pattern), ZSTR_VAL(ce->name), ZSTR_LEN(ce->name))) {
+                php_rayaop_apply_matchers(ce); /* Attaches the handlers to matching methods */
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+    php_rayaop_batch_end(true); /* Install the hooks on the first matcher */
+
+    RETURN_TRUE; /* Return true and end */
+}
+/* }}} */
+
+/* {{{ proto array rayaop_stats(bool reset = false)
+   Function to get the call statistics collected while rayaop.stats is enabled
+
+   Statistics are kept per worker process (or thread) and survive requests. Times are wall-clock
+   nanoseconds; "interceptor_time" is the part of "total_time" not spent in the original method.
+
+   @param bool reset Whether to reset the statistics after reading them
+   @return array The statistics ("enabled", "rejected" and "bindings" keyed by "class::method")
+*/
+PHP_FUNCTION(rayaop_stats) {
+    bool reset = false; /* Whether to reset the statistics */
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(reset) /* Parse reset parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    zval bindings;
+    array_init(&bindings);
+    if (RAYAOP_G(stats_ht)) {
+        zend_string *key;
+        php_rayaop_binding_stats *stats;
+        ZEND_HASH_FOREACH_STR_KEY_PTR(RAYAOP_G(stats_ht), key, stats) {
+            zval entry;
+            array_init_size(&entry, 6);
+            add_assoc_long(&entry, "calls", (zend_long) stats->calls);
+            add_assoc_long(&entry, "total_time", (zend_long) stats->total_ns);
+            add_assoc_long(&entry, "max_time", (zend_long) stats->max_ns);
+            add_assoc_long(&entry, "original_time", (zend_long) stats->original_ns);
+            add_assoc_long(&entry, "max_original_time", (zend_long) stats->max_original_ns);
+            add_assoc_long(&entry, "interceptor_time", (zend_long) (stats->total_ns - stats->original_ns));
+            add_assoc_zval_ex(&bindings, ZSTR_VAL(key), ZSTR_LEN(key), &entry);
+            if (reset) {
+                memset(stats, 0, sizeof(php_rayaop_binding_stats)); /* Kept: intercept information points to it */
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+
+    array_init_size(return_value, 3);
+    add_assoc_bool(return_value, "enabled", RAYAOP_G(stats));
+    add_assoc_long(return_value, "rejected", (zend_long) RAYAOP_G(stats_rejected));
+    add_assoc_zval(return_value, "bindings", &bindings);
+    if (reset) {
+        RAYAOP_G(stats_rejected) = 0;
+    }
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_memo_key(zend_execute_data *execute_data, smart_str *key)
+   Function to build the cache key of a call from the arguments in its frame
+
+   The key starts with the receiver: the object handle for instance calls, or the called class
+   (static::) otherwise, so objects and subclasses never share results. Arguments are encoded as
+   a type tag followed by their binary value, so no serialization happens. Arrays, objects and
+   resources make a call uncacheable.
+
+   @param zend_execute_data *execute_data The execution data of the intercepted call
+   @param smart_str *key Receives the key
+   @return bool Returns true if the call can be cached
+*/
+static bool php_rayaop_memo_key(zend_execute_data *execute_data, smart_str *key) {
+    uint32_t num_args = ZEND_CALL_NUM_ARGS(execute_data); /* Number of passed arguments */
+
+    if (UNEXPECTED(ZEND_CALL_INFO(execute_data) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS)) {
+        return false; /* Collected named arguments are not encoded */
+    }
+    if (Z_TYPE(execute_data->This) == IS_OBJECT) {
+        uint32_t handle = Z_OBJ_HANDLE(execute_data->This);
+        smart_str_appendc(key, 'o');
+        smart_str_appendl(key, (const char *) &handle, sizeof(handle)); /* Receiver object */
+    } else {
+        void *scope = Z_PTR(execute_data->This);
+        smart_str_appendc(key, 's');
+        smart_str_appendl(key, (const char *) &scope, sizeof(scope)); /* Called class (NULL for functions) */
+    }
+    smart_str_appendl(key, (const char *) &num_args, sizeof(num_args));
+    for (uint32_t i = 0; i < num_args; i++) {
+        zval *arg = php_rayaop_frame_arg(execute_data, i);
+        ZVAL_DEREF(arg);
+        smart_str_appendc(key, (char) Z_TYPE_P(arg)); /* Type tag */
+        switch (Z_TYPE_P(arg)) {
+            case IS_NULL:
+            case IS_FALSE:
+            case IS_TRUE:
+                break;
+            case IS_LONG:
+                smart_str_appendl(key, (const char *) &Z_LVAL_P(arg), sizeof(zend_long));
+                break;
+            case IS_DOUBLE:
+                smart_str_appendl(key, (const char *) &Z_DVAL_P(arg), sizeof(double));
+                break;
+            case IS_STRING: {
+                size_t len = Z_STRLEN_P(arg);
+                smart_str_appendl(key, (const char *) &len, sizeof(len)); /* Length prefix keeps keys unambiguous */
+                smart_str_appendl(key, Z_STRVAL_P(arg), len);
+                break;
+            }
+            default:
+                return false; /* Not cacheable */
+        }
+    }
+    smart_str_0(key);
+    return true;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_memo_around(php_rayaop_invocation *invocation, zval *retval, void *user_data)
+   Around advice of method_memoize() bindings
+
+   A cached result is returned without proceeding, so neither the interceptors after this one nor
+   the original method run. Results are only cached when the call returns normally.
+
+   @param php_rayaop_invocation *invocation The active invocation
+   @param zval *retval Receives the result
+   @param void *user_data The result cache (php_rayaop_memo)
+*/
+static void php_rayaop_memo_around(php_rayaop_invocation *invocation, zval *retval, void *user_data) {
+    php_rayaop_memo *memo = user_data;
+    zend_execute_data *execute_data = invocation->execute_data;
+    smart_str key = {0};
+
+    if ((execute_data->func->common.fn_flags & ZEND_ACC_RETURN_REFERENCE) || !php_rayaop_memo_key(execute_data, &key)) {
+        smart_str_free(&key);
+        php_rayaop_proceed(invocation, retval); /* Not cacheable */
+        return;
+    }
+
+    zval *cached = zend_hash_find(&memo->results, key.s);
+    if (cached) {
+        ZVAL_COPY(retval, cached);
+        if (cached != &memo->results.arData[memo->results.nNumUsed - 1].val) {
+            /* Move to the most recently used end */
+            zend_hash_del(&memo->results, key.s);
+            Z_TRY_ADDREF_P(retval);
+            zend_hash_add_new(&memo->results, key.s, retval);
+        }
+        smart_str_free(&key);
+        return;
+    }
+
+    php_rayaop_proceed(invocation, retval);
+    if (!EG(exception) && !Z_ISUNDEF_P(retval)) {
+        if ((zend_long) zend_hash_num_elements(&memo->results) >= memo->max_entries) {
+            zend_string *oldest;
+            ZEND_HASH_FOREACH_STR_KEY(&memo->results, oldest) {
+                zend_hash_del(&memo->receivers, oldest); /* Evict the least recently used result */
+                zend_hash_del(&memo->results, oldest);
+                break;
+            } ZEND_HASH_FOREACH_END();
+        }
+        Z_TRY_ADDREF_P(retval);
+        zend_hash_update(&memo->results, key.s, retval); /* A recursive call may have cached it already */
+        if (Z_TYPE(execute_data->This) == IS_OBJECT) {
+            Z_ADDREF(execute_data->This);
+            zend_hash_update(&memo->receivers, key.s, &execute_data->This); /* Held while its result is cached */
+        }
+    }
+    smart_str_free(&key);
+}
+/* }}} */
+
+/* Advice of method_memoize() bindings */
+static const php_rayaop_advice php_rayaop_memo_advice = {NULL, php_rayaop_memo_around, NULL};
+
+/* {{{ proto void php_rayaop_free_memo(zval *zv)
+   Function to free the result cache of a method_memoize() binding
+
+   @param zval *zv The zval containing the result cache to be freed
+*/
+static void php_rayaop_free_memo(zval *zv) {
+    php_rayaop_memo *memo = Z_PTR_P(zv); /* Get result cache pointer from zval */
+    zend_hash_destroy(&memo->results); /* Release cached results */
+    zend_hash_destroy(&memo->receivers); /* Release their objects */
+    efree(memo); /* Free memory for result cache */
+}
+/* }}} */
+
+/* {{{ proto bool method_memoize(string class_name, string method_name, array options = [])
+   Function to cache the results of a method by its arguments for the rest of the request
+
+   The binding is prepended to the interceptor chain, so a cached result is returned before any
+   interceptor runs. Calls are cached per object (or called class) by their null, bool, int, float
+   and string arguments; calls with other arguments always proceed. Binding the method again replaces its cache.
+   Supported options: "max_entries" (int, default 1000), the number of results kept before the
+   least recently used one is evicted.
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param array options Options
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_memoize) {
+    zend_string *class_name, *method_name; /* Class name and method name */
+    HashTable *options = NULL; /* Options */
+
+    ZEND_PARSE_PARAMETERS_START(2, 3)
+        Z_PARAM_STR(class_name) /* Parse class name parameter */
+        Z_PARAM_STR(method_name) /* Parse method name parameter */
+        Z_PARAM_OPTIONAL
+        Z_PARAM_ARRAY_HT(options) /* Parse options parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    zend_long max_entries = 1000; /* Default cache size */
+    zval *option = options ? zend_hash_str_find(options, "max_entries", sizeof("max_entries") - 1) : NULL;
+    if (option) {
+        max_entries = zval_get_long(option);
+        if (max_entries < 1) {
+            zend_argument_value_error(3, "option \"max_entries\" must be greater than 0");
+            RETURN_THROWS();
+        }
+    }
+
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, ZSTR_VAL(class_name), ZSTR_LEN(class_name), ZSTR_VAL(method_name), ZSTR_LEN(method_name), &key_len);
+    php_rayaop_intercept_info *info = php_rayaop_find_intercept_info(key, key_len); /* Current chain */
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    if (info) {
+        for (uint32_t i = 0; i < info->handler_count; i++) {
+            if (info->handlers[i].advice == &php_rayaop_memo_advice) {
+                /* Drop the previous cache (freed at the end of the request) */
+                php_rayaop_register_advice(ZSTR_VAL(class_name), ZSTR_LEN(class_name), ZSTR_VAL(method_name), ZSTR_LEN(method_name),
+                                           &php_rayaop_memo_advice, info->handlers[i].advice_data, PHP_RAYAOP_CHAIN_REMOVE);
+                break;
+            }
+        }
+    }
+
+    php_rayaop_memo *memo = emalloc(sizeof(php_rayaop_memo)); /* Allocate result cache */
+    zend_hash_init(&memo->results, 8, NULL, ZVAL_PTR_DTOR, 0);
+    zend_hash_init(&memo->receivers, 8, NULL, ZVAL_PTR_DTOR, 0);
+    memo->max_entries = max_entries;
+    zend_hash_next_index_insert_ptr(RAYAOP_G(memos), memo); /* Owned by the request */
+
+    if (!php_rayaop_register_advice(ZSTR_VAL(class_name), ZSTR_LEN(class_name), ZSTR_VAL(method_name), ZSTR_LEN(method_name),
+                                    &php_rayaop_memo_advice, memo, PHP_RAYAOP_CHAIN_PREPEND)) {
+        RETURN_FALSE; /* Return false and end */
+    }
+    RETURN_TRUE; /* Return true and end */
+}
+/* }}} */
+
+/* {{{ proto zend_string* php_rayaop_registry_string(const char *str, size_t len)
+   Function to get a string of the process-wide registry
+
+   The string is flagged like an interned string, so threads reading it (as a hash key, or when
+   it is passed to zend_lookup_class()) never touch its reference count. The hash is computed
+   before the string is published. Each name is allocated once, so registering the same binding
+   again does not grow persistent memory. Must be called with the registry mutex held under ZTS.
+
+   @param const char *str The characters
+   @param size_t len The length
+   @return zend_string* The immutable persistent string
+*/
+static zend_string *php_rayaop_registry_string(const char *str, size_t len) {
+    if (!php_rayaop_registry_strings) {
+        php_rayaop_registry_strings = pemalloc(sizeof(HashTable), 1);
+        zend_hash_init(php_rayaop_registry_strings, 64, NULL, NULL, 1); /* The strings are freed by php_rayaop_registry_free() */
+    }
+
+    zend_string *string = zend_hash_str_find_ptr(php_rayaop_registry_strings, str, len); /* Search for the name */
+    if (string) {
+        return string;
+    }
+    string = zend_string_init(str, len, 1); /* Persistent copy */
+    zend_string_hash_val(string);
+    GC_SET_REFCOUNT(string, 2);
+    GC_TYPE_INFO(string) = GC_STRING | ((IS_STR_INTERNED | IS_STR_PERSISTENT | IS_STR_PERMANENT) << GC_FLAGS_SHIFT);
+    zend_hash_add_new_ptr(php_rayaop_registry_strings, string, string); /* The string is its own key */
+    return string;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_addref_persistent_info(zval *zv)
+   Function to take a reference to persistent intercept information for a copied registry
+
+   @param zval *zv The zval containing the persistent intercept information
+*/
+static void php_rayaop_addref_persistent_info(zval *zv) {
+    ((php_rayaop_persistent_info *) Z_PTR_P(zv))->refcount++;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_release_persistent_info(zval *zv)
+   Function to release a registry's reference to persistent intercept information
+
+   The information is freed when no registry holds it; its strings belong to the string table.
+
+   @param zval *zv The zval containing the persistent intercept information
+*/
+static void php_rayaop_release_persistent_info(zval *zv) {
+    php_rayaop_persistent_info *info = Z_PTR_P(zv); /* Get persistent information pointer from zval */
+    if (--info->refcount == 0) {
+        pefree(info, 1); /* Free memory for persistent information structure */
+    }
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_registry* php_rayaop_registry_alloc(php_rayaop_registry *base)
+   Function to allocate a process-wide registry
+
+   @param php_rayaop_registry *base The registry to copy the bindings of (NULL for an empty registry)
+   @return php_rayaop_registry* The new registry (not yet published)
+*/
+static php_rayaop_registry *php_rayaop_registry_alloc(php_rayaop_registry *base) {
+    php_rayaop_registry *registry = pemalloc(sizeof(php_rayaop_registry), 1); /* Allocate registry */
+    uint32_t size = base ? zend_hash_num_elements(&base->bindings) + 1 : 8; /* Sized once, the copy is never resized again */
+
+    zend_hash_init(&registry->bindings, size, NULL, php_rayaop_release_persistent_info, 1); /* Bindings are shared with the registries they were copied from */
+    zend_hash_init(&registry->classes, base ? zend_hash_num_elements(&base->classes) + 1 : 8, NULL, NULL, 1);
+    if (base) {
+        zend_hash_copy(&registry->bindings, &base->bindings, php_rayaop_addref_persistent_info); /* Keys are immutable, so only the bindings are counted */
+        zend_hash_copy(&registry->classes, &base->classes, NULL);
+    }
+    registry->readers = 0;
+    registry->retired = NULL;
+    return registry;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_destroy(php_rayaop_registry *registry)
+   Function to free a registry that no thread reads
+
+   @param php_rayaop_registry *registry The registry
+*/
+static void php_rayaop_registry_destroy(php_rayaop_registry *registry) {
+    zend_hash_destroy(&registry->bindings); /* Release the bindings */
+    zend_hash_destroy(&registry->classes); /* Destroy hash table */
+    pefree(registry, 1); /* Free memory for registry */
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_registry_contains(php_rayaop_registry *registry, const char *key, size_t key_len, const char *handler_class, size_t handler_class_len)
+   Function to check whether a registry binds a method to an interceptor class already
+
+   @param php_rayaop_registry *registry The registry
+   @param const char *key The intercept key
+   @param size_t key_len The length of the intercept key
+   @param const char *handler_class The interceptor class name
+   @param size_t handler_class_len The length of the interceptor class name
+   @return bool Returns true if the binding exists
+*/
+static bool php_rayaop_registry_contains(php_rayaop_registry *registry, const char *key, size_t key_len, const char *handler_class, size_t handler_class_len) {
+    php_rayaop_persistent_info *info = zend_hash_str_find_ptr(&registry->bindings, key, key_len); /* Current binding */
+    return info && ZSTR_LEN(info->handler_class) == handler_class_len &&
+           memcmp(ZSTR_VAL(info->handler_class), handler_class, handler_class_len) == 0;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_bind(php_rayaop_registry *registry, php_rayaop_persistent_info *info)
+   Function to store a binding in a registry that is not published yet (or not shared)
+
+   The registry takes over the reference passed by the caller. Must be called with the registry
+   mutex held under ZTS.
+*/
+static void php_rayaop_registry_bind(php_rayaop_registry *registry, php_rayaop_persistent_info *info) {
+    zend_hash_update_ptr(&registry->bindings, info->key, info); /* Releases the replaced binding */
+    if (!zend_hash_exists(&registry->classes, info->class_name)) {
+        zval marker;
+        ZVAL_TRUE(&marker);
+        zend_hash_add_new(&registry->classes, info->class_name, &marker); /* Mark the class */
+    }
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_registry_add(php_rayaop_registry *registry, const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const char *handler_class, size_t handler_class_len)
+   Function to add (or replace) a binding in a registry that is not published yet (or not shared)
+
+   A binding that is registered already with the same interceptor class is left as it is. A
+   replaced binding is freed unless another registry still holds it. Must be called with the
+   registry mutex held under ZTS.
+
+   @return bool Returns true if the registry changed
+*/
+static bool php_rayaop_registry_add(php_rayaop_registry *registry, const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const char *handler_class, size_t handler_class_len) {
+    char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+    size_t key_len;
+    char *key = php_rayaop_build_intercept_key(buf, class_name, class_name_len, method_name, method_name_len, &key_len);
+    if (php_rayaop_registry_contains(registry, key, key_len, handler_class, handler_class_len)) {
+        PHP_RAYAOP_RELEASE_KEY(key, buf);
+        return false; /* Registered already */
+    }
+
+    php_rayaop_persistent_info *info = pemalloc(sizeof(php_rayaop_persistent_info), 1); /* Allocate persistent information */
+    info->key = php_rayaop_registry_string(key, key_len);
+    PHP_RAYAOP_RELEASE_KEY(key, buf);
+    info->class_name = php_rayaop_registry_string(class_name, class_name_len);
+    info->method_name = php_rayaop_registry_string(method_name, method_name_len);
+    info->handler_class = php_rayaop_registry_string(handler_class, handler_class_len);
+    info->refcount = 1; /* Held by this registry */
+
+    php_rayaop_registry_bind(registry, info); /* Add or replace the persistent binding */
+    return true;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_view(void)
+   Function to point the current request at the persistent bindings it sees
+
+   Under ZTS this is the registry attached at the start of the request, or the private copy once
+   the request registered a binding itself.
+*/
+static void php_rayaop_registry_view(void) {
+#ifdef ZTS
+    php_rayaop_registry *registry = RAYAOP_G(registry_draft) ? RAYAOP_G(registry_draft) : RAYAOP_G(registry);
+#else
+    php_rayaop_registry *registry = php_rayaop_registry_current;
+#endif
+    RAYAOP_G(persistent_ht) = registry ? &registry->bindings : NULL;
+    RAYAOP_G(persistent_classes) = registry ? &registry->classes : NULL;
+}
+/* }}} */
+
+#ifdef ZTS
+/* {{{ proto void php_rayaop_registry_publish(php_rayaop_registry *registry)
+   Function to replace the published registry (ZTS)
+
+   The replaced registry is freed right away unless a request still reads it. Must be called with
+   the registry mutex held.
+
+   @param php_rayaop_registry *registry The registry to publish
+*/
+static void php_rayaop_registry_publish(php_rayaop_registry *registry) {
+    php_rayaop_registry *current = php_rayaop_registry_current; /* Stable while the mutex is held */
+    PHP_RAYAOP_ATOMIC_STORE_PTR(&php_rayaop_registry_current, registry); /* Publish */
+    if (!current) {
+        return;
+    }
+    if (current->readers == 0) {
+        php_rayaop_registry_destroy(current); /* Nobody reads it */
+    } else {
+        current->retired = php_rayaop_registry_retired; /* Freed when its last reader detaches */
+        php_rayaop_registry_retired = current;
+    }
+}
+/* }}} */
+#endif
+
+/* {{{ proto void php_rayaop_registry_attach(void)
+   Function to attach the current request to the published registry
+
+   Called at the start of each request, so bindings published by other threads are seen from the
+   next request on. Under ZTS the request counts as a reader of the registry until it detaches,
+   which keeps the registry alive after it is replaced.
+*/
+static void php_rayaop_registry_attach(void) {
+#ifdef ZTS
+    RAYAOP_G(registry) = NULL;
+    RAYAOP_G(registry_draft) = NULL;
+    if (PHP_RAYAOP_ATOMIC_LOAD_PTR(&php_rayaop_registry_current)) {
+        /* Only lock once a registry exists */
+        tsrm_mutex_lock(php_rayaop_registry_mutex);
+        php_rayaop_registry *registry = php_rayaop_registry_current; /* Stable while the mutex is held */
+        registry->readers++;
+        RAYAOP_G(registry) = registry;
+        tsrm_mutex_unlock(php_rayaop_registry_mutex);
+    }
+#endif
+    php_rayaop_registry_view();
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_detach(void)
+   Function to detach the current request from the published registry (ZTS)
+
+   The bindings registered by the request are published in one step. If another thread published
+   a registry in the meantime, they are added to a copy of it, so no registration is lost. A
+   replaced registry is freed once its last reader detaches.
+*/
+static void php_rayaop_registry_detach(void) {
+#ifdef ZTS
+    php_rayaop_registry *attached = RAYAOP_G(registry);
+    php_rayaop_registry *draft = RAYAOP_G(registry_draft);
+    if (!attached && !draft) {
+        return; /* Nothing to publish or release */
+    }
+
+    tsrm_mutex_lock(php_rayaop_registry_mutex);
+    if (draft) {
+        if (php_rayaop_registry_current != attached) {
+            /* Replay the bindings of this request on the registry published meanwhile */
+            php_rayaop_registry *merged = php_rayaop_registry_alloc(php_rayaop_registry_current);
+            php_rayaop_persistent_info *info;
+            ZEND_HASH_FOREACH_PTR(&draft->bindings, info) {
+                if (!attached || zend_hash_find_ptr(&attached->bindings, info->key) != info) {
+                    info->refcount++; /* Registered by this request */
+                    php_rayaop_registry_bind(merged, info);
+                }
+            } ZEND_HASH_FOREACH_END();
+            php_rayaop_registry_destroy(draft); /* Never published */
+            draft = merged;
+        }
+        php_rayaop_registry_publish(draft);
+    }
+    if (attached && --attached->readers == 0 && attached != php_rayaop_registry_current) {
+        /* Last reader of a replaced registry */
+        php_rayaop_registry **link = &php_rayaop_registry_retired;
+        while (*link != attached) {
+            link = &(*link)->retired;
+        }
+        *link = attached->retired; /* Unlink */
+        php_rayaop_registry_destroy(attached);
+    }
+    tsrm_mutex_unlock(php_rayaop_registry_mutex);
+
+    RAYAOP_G(registry) = NULL;
+    RAYAOP_G(registry_draft) = NULL;
+    RAYAOP_G(persistent_ht) = NULL;
+    RAYAOP_G(persistent_classes) = NULL;
+#endif
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_registry_register(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const char *handler_class, size_t handler_class_len)
+   Function to register a persistent binding in the process-wide registry
+
+   Under ZTS the published registry is never modified: the first binding a request registers
+   copies the registry it is attached to, later ones are added to that private copy, and the copy
+   is published once at the end of the request. A binding that exists already is detected before
+   anything is copied. Without threads the registry is updated in place.
+
+   @return bool Returns true if the registry changed
+*/
+static bool php_rayaop_registry_register(const char *class_name, size_t class_name_len, const char *method_name, size_t method_name_len, const char *handler_class, size_t handler_class_len) {
+#ifdef ZTS
+    php_rayaop_registry *draft = RAYAOP_G(registry_draft);
+    if (!draft && RAYAOP_G(registry)) {
+        char buf[PHP_RAYAOP_KEY_SIZE]; /* Storage of the key */
+        size_t key_len;
+        char *key = php_rayaop_build_intercept_key(buf, class_name, class_name_len, method_name, method_name_len, &key_len);
+        bool exists = php_rayaop_registry_contains(RAYAOP_G(registry), key, key_len, handler_class, handler_class_len); /* The attached registry is immutable */
+        PHP_RAYAOP_RELEASE_KEY(key, buf);
+        if (exists) {
+            return false; /* Registered already: nothing is copied */
+        }
+    }
+
+    tsrm_mutex_lock(php_rayaop_registry_mutex); /* Bindings and names are shared with other registries */
+    if (!draft) {
+        draft = php_rayaop_registry_alloc(RAYAOP_G(registry)); /* Copied once per request */
+        RAYAOP_G(registry_draft) = draft;
+    }
+    bool changed = php_rayaop_registry_add(draft, class_name, class_name_len, method_name, method_name_len, handler_class, handler_class_len);
+    tsrm_mutex_unlock(php_rayaop_registry_mutex);
+    return changed;
+#else
+    if (!php_rayaop_registry_current) {
+        php_rayaop_registry_current = php_rayaop_registry_alloc(NULL); /* Allocated on first use */
+    }
+    return php_rayaop_registry_add(php_rayaop_registry_current, class_name, class_name_len, method_name, method_name_len, handler_class, handler_class_len);
+#endif
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_load(php_rayaop_registry *registry, const char *spec)
+   Function to load the persistent bindings of rayaop.bindings at module startup
+
+   Entries have the form "Class::method=InterceptorClass" and are separated by commas,
+   semicolons or whitespace.
+
+   @param php_rayaop_registry *registry The registry (not published yet)
+   @param const char *spec The INI value
+*/
+static void php_rayaop_registry_load(php_rayaop_registry *registry, const char *spec) {
+    const char *p = spec;
+
+    while (*p) {
+        size_t len = strcspn(p, ",; \t\r\n"); /* Length of the entry */
+        if (len > 0) {
+            const char *separator = zend_memnstr(p, "::", 2, p + len); /* End of the class name */
+            const char *equals = separator ? memchr(separator, '=', len - (separator - p)) : NULL; /* End of the method name */
+            if (!separator || !equals || separator == p || equals == separator + 2 || equals + 1 == p + len) {
+                php_error_docref(NULL, E_WARNING, "Invalid rayaop.bindings entry \"%.*s\", expected Class::method=Interceptor", (int) len, p);
+            } else {
+                const char *class_name = (*p == '\\') ? p + 1 : p; /* Strip the leading separator */
+                php_rayaop_registry_add(registry, class_name, separator - class_name, separator + 2, equals - separator - 2, equals + 1, p + len - equals - 1);
+            }
+        }
+        p += len;
+        p += strspn(p, ",; \t\r\n"); /* Skip separators */
+    }
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_registry_parse(php_rayaop_registry *registry, const char *image, size_t len)
+   Function to add the bindings of a registry image to a registry that is not published yet
+
+   The image is validated completely before the first binding is added, so a truncated or foreign
+   file adds nothing. The registry is grown once for all bindings.
+
+   @param php_rayaop_registry *registry The registry
+   @param const char *image The image
+   @param size_t len The length of the image
+   @return bool Returns true if the image is valid
+*/
+static bool php_rayaop_registry_parse(php_rayaop_registry *registry, const char *image, size_t len) {
+    php_rayaop_registry_header header;
+
+    if (len < sizeof(header)) {
+        return false; /* Too short for the header */
+    }
+    memcpy(&header, image, sizeof(header)); /* The image is not necessarily aligned */
+    if (memcmp(header.magic, PHP_RAYAOP_REGISTRY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PHP_RAYAOP_REGISTRY_VERSION || header.size != len) {
+        return false; /* Not an image of this version and byte order, or truncated */
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        /* Validate the records, then add them */
+        const char *p = image + sizeof(header); /* Next record */
+        const char *end = image + len;
+        if (pass == 1) {
+            zend_hash_extend(&registry->bindings, zend_hash_num_elements(&registry->bindings) + header.count, 0); /* Grow once (string keys, never packed) */
+        }
+        for (uint32_t i = 0; i < header.count; i++) {
+            uint32_t lens[3]; /* Lengths of the class, method and interceptor class names */
+            const char *names[3];
+            if ((size_t) (end - p) < sizeof(lens)) {
+                return false;
+            }
+            memcpy(lens, p, sizeof(lens));
+            p += sizeof(lens);
+            for (int n = 0; n < 3; n++) {
+                if ((size_t) (end - p) <= lens[n] || p[lens[n]] != '\0') {
+                    return false; /* Name overruns the image or is not terminated */
+                }
+                names[n] = p;
+                p += lens[n] + 1;
+            }
+            if (lens[1] == 0 || lens[2] == 0) {
+                return false; /* The class name is empty for functions only */
+            }
+            if (pass == 1) {
+                php_rayaop_registry_add(registry, names[0], lens[0], names[1], lens[1], names[2], lens[2]);
+            }
+        }
+        if (p != end) {
+            return false; /* Trailing bytes */
+        }
+    }
+    return true;
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_load_file(php_rayaop_registry *registry, const char *path)
+   Function to load the registry image of rayaop.registry_file at module startup
+
+   The file is memory-mapped where the stream supports it (read otherwise), so startup costs one
+   pass over the image instead of evaluating matchers against the class graph.
+
+   @param php_rayaop_registry *registry The registry (not published yet)
+   @param const char *path The path of the image
+*/
+static void php_rayaop_registry_load_file(php_rayaop_registry *registry, const char *path) {
+    php_stream *stream = php_stream_open_wrapper((char *) path, "rb", REPORT_ERRORS, NULL);
+    if (!stream) {
+        return; /* The stream layer reported the error */
+    }
+
+    size_t len = 0;
+    zend_string *copy = NULL; /* Contents read into memory if the stream cannot be mapped */
+    char *image = php_stream_mmap_range(stream, 0, PHP_STREAM_MMAP_ALL, PHP_STREAM_MAP_MODE_SHARED_READONLY, &len);
+    if (!image) {
+        copy = php_stream_copy_to_mem(stream, PHP_STREAM_COPY_ALL, 0);
+        image = copy ? ZSTR_VAL(copy) : NULL;
+        len = copy ? ZSTR_LEN(copy) : 0;
+    }
+
+    if (!image || !php_rayaop_registry_parse(registry, image, len)) {
+        php_error_docref(NULL, E_WARNING, "Invalid rayaop.registry_file \"%s\", regenerate it with rayaop_registry_export()", path);
+    }
+
+    if (copy) {
+        zend_string_release(copy);
+    } else if (image) {
+        php_stream_mmap_unmap(stream);
+    }
+    php_stream_close(stream);
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_free(void)
+   Function to free the process-wide registry and the replaced registries still kept (module shutdown)
+*/
+static void php_rayaop_registry_free(void) {
+    if (php_rayaop_registry_current) {
+        php_rayaop_registry_destroy(php_rayaop_registry_current); /* Frees the bindings no other registry holds */
+        php_rayaop_registry_current = NULL;
+    }
+#ifdef ZTS
+    while (php_rayaop_registry_retired) {
+        php_rayaop_registry *retired = php_rayaop_registry_retired->retired;
+        php_rayaop_registry_destroy(php_rayaop_registry_retired); /* Readers that never detached */
+        php_rayaop_registry_retired = retired;
+    }
+#endif
+    if (php_rayaop_registry_strings) {
+        zend_string *string;
+        ZEND_HASH_FOREACH_PTR(php_rayaop_registry_strings, string) {
+            pefree(string, 1); /* Immutable strings are not reference counted */
+        } ZEND_HASH_FOREACH_END();
+        zend_hash_destroy(php_rayaop_registry_strings); /* Keys are the freed strings, which are never read again */
+        pefree(php_rayaop_registry_strings, 1);
+        php_rayaop_registry_strings = NULL;
+    }
+}
+/* }}} */
+
+/* {{{ proto bool php_rayaop_resolve_persistent_handler(zend_string *handler_class, zval *handler)
+   Function to get the interceptor instance of a persistent binding for the current request
+
+   Interceptors are instantiated (without constructor arguments) on first use and shared by all
+   persistent bindings that name the same interceptor class during the request.
+
+   @param zend_string *handler_class The interceptor class name
+   @param zval *handler Receives the interceptor object (borrowed from the request cache)
+   @return bool Returns true on success or false on failure
+*/
+static bool php_rayaop_resolve_persistent_handler(zend_string *handler_class, zval *handler) {
+    zval *cached = zend_hash_str_find(RAYAOP_G(persistent_handlers), ZSTR_VAL(handler_class), ZSTR_LEN(handler_class)); /* Search for an existing instance */
+    if (cached) {
+        ZVAL_COPY_VALUE(handler, cached);
+        return true;
+    }
+
+    zend_class_entry *ce = zend_lookup_class(handler_class); /* Look up (and autoload) the interceptor class */
+    if (!ce || (!instanceof_function(ce, ray_aop_method_interceptor_interface_ce) && !instanceof_function(ce, ray_aop_native_method_interceptor_interface_ce))) {
+        php_error_docref(NULL, E_WARNING, "Interceptor class %s does not exist or does not implement an interceptor interface", ZSTR_VAL(handler_class));
+        return false;
+    }
+
+    zval object;
+    if (object_init_ex(&object, ce) != SUCCESS) {
+        return false;
+    }
+    if (ce->constructor) {
+        zend_call_known_instance_method_with_0_params(ce->constructor, Z_OBJ(object), NULL); /* Call the constructor */
+        if (EG(exception)) {
+            zval_ptr_dtor(&object);
+            return false;
+        }
+    }
+
+    zend_hash_str_update(RAYAOP_G(persistent_handlers), ZSTR_VAL(handler_class), ZSTR_LEN(handler_class), &object); /* The request cache owns the instance */
+    ZVAL_COPY_VALUE(handler, &object);
+    return true;
+}
+/* }}} */
+
+/* {{{ proto php_rayaop_intercept_info* php_rayaop_materialize_persistent_info(const char *key, size_t key_len)
+   Function to turn a persistent binding into intercept information of the current request
+
+   @param const char *key The intercept key
+   @param size_t key_len The length of the intercept key
+   @return php_rayaop_intercept_info* Pointer to the intercept information if a persistent binding exists, NULL otherwise
+*/
+php_rayaop_intercept_info *php_rayaop_materialize_persistent_info(const char *key, size_t key_len) {
+    if (!RAYAOP_G(persistent_ht)) {
+        return NULL;
+    }
+
+    php_rayaop_persistent_info *persistent = zend_hash_str_find_ptr(RAYAOP_G(persistent_ht), key, key_len); /* Search for persistent binding */
+    zval handler;
+    if (!persistent || !php_rayaop_resolve_persistent_handler(persistent->handler_class, &handler)) {
+        return NULL;
+    }
+
+    if (!php_rayaop_register_intercept(ZSTR_VAL(persistent->class_name), ZSTR_LEN(persistent->class_name),
+            ZSTR_VAL(persistent->method_name), ZSTR_LEN(persistent->method_name), &handler, PHP_RAYAOP_CHAIN_REPLACE)) {
+        return NULL;
+    }
+    PHP_RAYAOP_DEBUG_PRINT("Materialized persistent binding %.*s", (int) key_len, key); /* Output debug information */
+    return php_rayaop_find_intercept_info(key, key_len);
+}
+/* }}} */
+
+/* {{{ proto bool method_intercept_persistent(string class_name, string method_name, string interceptor_class)
+   Function to register an intercept method for the lifetime of the worker process
+
+   The binding is stored by name in persistent memory and survives the end of the request, so a
+   bootstrap (or an opcache preload script) only has to register it once per worker. Under ZTS
+   the registry is shared by all threads of the process. The interceptor class is instantiated
+   lazily in each request (and thread) when the method is first called. Bindings registered with
+   method_intercept() take precedence within a request.
+
+   @param string class_name The name of the class
+   @param string method_name The name of the method
+   @param string interceptor_class The name of a class implementing an interceptor interface
+   @return bool Returns TRUE on success or FALSE on failure
+*/
+PHP_FUNCTION(method_intercept_persistent) {
+    zend_string *class_name, *method_name, *handler_class; /* Class name, method name and interceptor class name */
+
+    ZEND_PARSE_PARAMETERS_START(3, 3)
+        Z_PARAM_STR(class_name) /* Parse class name parameter */
+        Z_PARAM_STR(method_name) /* Parse method name parameter */
+        Z_PARAM_STR(handler_class) /* Parse interceptor class parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!php_rayaop_registry_register(ZSTR_VAL(class_name), ZSTR_LEN(class_name), ZSTR_VAL(method_name), ZSTR_LEN(method_name),
+                                      ZSTR_VAL(handler_class), ZSTR_LEN(handler_class))) {
+        RETURN_TRUE; /* Registered already (a bootstrap running in every request): cached lookups stay valid */
+    }
+    php_rayaop_registry_view(); /* Under ZTS other threads see the binding once this request has ended */
+    php_rayaop_observer_attach_name(ZSTR_VAL(class_name), ZSTR_LEN(class_name), ZSTR_VAL(method_name), ZSTR_LEN(method_name)); /* Already called in this request */
+
+    php_rayaop_registry_changed(); /* Install the hooks on the first binding */
+    RETURN_TRUE; /* Return true and end */
+}
+/* }}} */
+
+/* {{{ proto void php_rayaop_registry_append(smart_str *image, zend_string *class_name, zend_string *method_name, zend_string *handler_class)
+   Function to append one binding to a registry image
+
+   @param smart_str *image The image
+   @param zend_string *class_name The name of the class (empty for functions)
+   @param zend_string *method_name The name of the method
+   @param zend_string *handler_class The name of the interceptor class
+*/
+static void php_rayaop_registry_append(smart_str *image, zend_string *class_name, zend_string *method_name, zend_string *handler_class) {
+    uint32_t lens[3] = {(uint32_t) ZSTR_LEN(class_name), (uint32_t) ZSTR_LEN(method_name), (uint32_t) ZSTR_LEN(handler_class)};
+    smart_str_appendl(image, (const char *) lens, sizeof(lens));
+    smart_str_appendl(image, ZSTR_VAL(class_name), ZSTR_LEN(class_name) + 1); /* Names are written with their NUL byte */
+    smart_str_appendl(image, ZSTR_VAL(method_name), ZSTR_LEN(method_name) + 1);
+    smart_str_appendl(image, ZSTR_VAL(handler_class), ZSTR_LEN(handler_class) + 1);
+}
+/* }}} */
+
+/* {{{ proto zend_class_entry* php_rayaop_exportable_handler(php_rayaop_intercept_info *info)
+   Function to get the interceptor class a binding can be rebuilt from
+
+   Only chains of a single interceptor object are exported, and only if its class has a name
+   that can be looked up and can be instantiated without constructor arguments.
+
+   @param php_rayaop_intercept_info *info The intercept information
+   @return zend_class_entry* The interceptor class, or NULL if the binding cannot be exported
+*/
+static zend_class_entry *php_rayaop_exportable_handler(php_rayaop_intercept_info *info) {
+    if (info->handler_count != 1 || info->handlers[0].advice || Z_TYPE(info->handlers[0].object) != IS_OBJECT) {
+        return NULL; /* Chain or native advice */
+    }
+    zend_class_entry *ce = Z_OBJCE(info->handlers[0].object);
+    if ((ce->ce_flags & ZEND_ACC_ANON_CLASS) || (ce->constructor && ce->constructor->common.required_num_args > 0)) {
+        return NULL; /* Cannot be instantiated by name */
+    }
+    return ce;
+}
+/* }}} */
+
+/* {{{ proto int|false rayaop_registry_export(string path)
+   Function to write the bindings of the current request to a registry image
+
+   The image holds every binding that can be rebuilt by name (see php_rayaop_exportable_handler())
+   and the persistent bindings that were not overridden, including bindings created by matchers.
+   Loaded with rayaop.registry_file, the bindings become persistent bindings at startup, so later
+   workers skip the bootstrap that computed them. The file is replaced atomically.
+
+   @param string path The path of the image
+   @return int|false Returns the number of exported bindings, or FALSE if the file cannot be written
+*/
+PHP_FUNCTION(rayaop_registry_export) {
+    zend_string *path; /* Path of the image */
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_PATH_STR(path) /* Parse path parameter */
+    ZEND_PARSE_PARAMETERS_END();
+
+    php_rayaop_registry_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PHP_RAYAOP_REGISTRY_MAGIC, sizeof(header.magic));
+    header.version = PHP_RAYAOP_REGISTRY_VERSION;
+
+    smart_str image = {0};
+    smart_str_appendl(&image, (const char *) &header, sizeof(header)); /* Count and size are filled in last */
+
+    php_rayaop_intercept_info *info;
+    ZEND_HASH_FOREACH_PTR(RAYAOP_G(intercept_ht), info) {
+        zend_class_entry *ce = php_rayaop_exportable_handler(info);
+        if (ce) {
+            php_rayaop_registry_append(&image, info->class_name, info->method_name, ce->name);
+            header.count++;
+        }
+    } ZEND_HASH_FOREACH_END();
+    if (RAYAOP_G(persistent_ht)) {
+        php_rayaop_persistent_info *persistent;
+        ZEND_HASH_FOREACH_PTR(RAYAOP_G(persistent_ht), persistent) {
+            if (!zend_hash_exists(RAYAOP_G(intercept_ht), persistent->key)) {
+                /* Not materialized (or overridden) in this request */
+                php_rayaop_registry_append(&image, persistent->class_name, persistent->method_name, persistent->handler_class);
+                header.count++;
+            }
+        } ZEND_HASH_FOREACH_END();
+    }
+    header.size = (uint32_t) ZSTR_LEN(image.s);
+    memcpy(ZSTR_VAL(image.s), &header, sizeof(header));
+
+    zend_string *tmp = zend_strpprintf(0, "%s.%d.tmp", ZSTR_VAL(path), (int) getpid()); /* Readers never see a partial image */
+    php_stream *stream = php_stream_open_wrapper(ZSTR_VAL(tmp), "wb", REPORT_ERRORS, NULL);
+    bool written = stream && php_stream_write(stream, ZSTR_VAL(image.s), ZSTR_LEN(image.s)) == ZSTR_LEN(image.s);
+    if (stream) {
+        php_stream_close(stream);
+    }
+    if (written && VCWD_RENAME(ZSTR_VAL(tmp), ZSTR_VAL(path)) != 0) {
+        php_error_docref(NULL, E_WARNING, "Cannot replace \"%s\": %s", ZSTR_VAL(path), strerror(errno));
+        written = false;
+    }
+    if (!written && stream) {
+        VCWD_UNLINK(ZSTR_VAL(tmp)); /* Drop the partial image */
+    }
+    zend_string_release(tmp);
+    smart_str_free(&image);
+
+    if (!written) {
+        RETURN_FALSE;
+    }
+    RETURN_LONG(header.count);
+}
+/* }}} */
+
+/* {{{ proto bool rayaop_enable()
+   Function to switch interception on for the rest of the request
+
+   Interception is enabled at the start of every request.
+
+   @return bool Returns whether interception was enabled before
+*/
+PHP_FUNCTION(rayaop_enable) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bool was_enabled = RAYAOP_G(enabled); /* Previous state */
+    RAYAOP_G(enabled) = 1;
+    php_rayaop_update_hooks(); /* Install the hooks if bindings exist */
+    RETURN_BOOL(was_enabled);
+}
+/* }}} */
+
+/* {{{ proto bool rayaop_disable()
+   Function to switch interception off for the rest of the request
+
+   Bindings stay registered; intercepted methods run their original implementation until
+   rayaop_enable() is called. Interceptors that are already running are not affected.
+
+   @return bool Returns whether interception was enabled before
+*/
+PHP_FUNCTION(rayaop_disable) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bool was_enabled = RAYAOP_G(enabled); /* Previous state */
+    RAYAOP_G(enabled) = 0;
+    php_rayaop_update_hooks(); /* Remove the hooks */
+    RETURN_BOOL(was_enabled);
+}
+/* }}} */
+
+/* Interface definition */
+zend_class_entry *ray_aop_method_interceptor_interface_ce;
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_method_interceptor_intercept, 0, 3, IS_MIXED, 0)
+    ZEND_ARG_TYPE_INFO(0, object, IS_OBJECT, 0) /* 1st argument: object */
+    ZEND_ARG_TYPE_INFO(0, method, IS_STRING, 0) /* 2nd argument: method name */
+    ZEND_ARG_TYPE_INFO(0, params, IS_ARRAY, 0) /* 3rd argument: parameter array */
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry ray_aop_method_interceptor_interface_methods[] = {
+    ZEND_ABSTRACT_ME(Ray_Aop_MethodInterceptorInterface, intercept, arginfo_ray_aop_method_interceptor_intercept)
+    /* Define intercept method */
+    PHP_FE_END /* End of function entries */
+};
+
+/* Native interceptor interface and invocation class */
+zend_class_entry *ray_aop_native_method_interceptor_interface_ce;
+zend_class_entry *ray_aop_native_method_invocation_ce;
+zend_class_entry *ray_aop_argument_view_ce;
+static zend_object_handlers php_rayaop_invocation_object_handlers;
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_interceptor_invoke, 0, 1, IS_MIXED, 0)
+    ZEND_ARG_OBJ_INFO(0, invocation, Ray\\Aop\\NativeMethodInvocation, 0) /* 1st argument: invocation */
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry ray_aop_native_method_interceptor_interface_methods[] = {
+    ZEND_ABSTRACT_ME(Ray_Aop_NativeMethodInterceptorInterface, invoke, arginfo_ray_aop_native_method_interceptor_invoke)
+    /* Define invoke method */
+    PHP_FE_END /* End of function entries */
+};
 
-   @param zend_rayaop_globals *rayaop_globals Pointer to global variables
+/* {{{ proto php_rayaop_invocation_object* php_rayaop_invocation_from_obj(zend_object *obj)
+   Function to get the invocation object from a zend_object
+
+   @param zend_object *obj The object
+   @return php_rayaop_invocation_object* The invocation object
 */
-static void php_rayaop_init_globals(zend_rayaop_globals *rayaop_globals) {
-    rayaop_globals->intercept_ht = NULL; /* Initialize intercept hash table */
-    rayaop_globals->is_intercepting = 0; /* Initialize intercept flag */
+static inline php_rayaop_invocation_object *php_rayaop_invocation_from_obj(zend_object *obj) {
+    return (php_rayaop_invocation_object *) ((char *) obj - XtOffsetOf(php_rayaop_invocation_object, std));
 }
 /* }}} */
 
-/* Macro for debug output */
-#ifdef RAYAOP_DEBUG
-#define PHP_RAYAOP_DEBUG_PRINT(fmt, ...) php_printf("RAYAOP DEBUG: " fmt "\n", ##__VA_ARGS__)  /* Output debug information */
-#else
-#define PHP_RAYAOP_DEBUG_PRINT(fmt, ...)  /* Do nothing if not in debug mode */
-#endif
+/* {{{ proto zend_object* php_rayaop_invocation_create_object(zend_class_entry *ce)
+   Object creation handler of Ray\Aop\NativeMethodInvocation
 
-/* Argument information for method_intercept function */
-ZEND_BEGIN_ARG_INFO_EX(arginfo_method_intercept, 0, 0, 3)
-    ZEND_ARG_TYPE_INFO(0, class_name, IS_STRING, 0) /* Argument information for class name */
-    ZEND_ARG_TYPE_INFO(0, method_name, IS_STRING, 0) /* Argument information for method name */
-    ZEND_ARG_OBJ_INFO(0, interceptor, Ray\\Aop\\MethodInterceptorInterface, 0) /* Argument information for intercept handler */
-ZEND_END_ARG_INFO()
+   @param zend_class_entry *ce The class entry
+   @return zend_object* The new object
+*/
+static zend_object *php_rayaop_invocation_create_object(zend_class_entry *ce) {
+    php_rayaop_invocation_object *intern = zend_object_alloc(sizeof(php_rayaop_invocation_object), ce); /* Allocate object */
 
-/* {{{ proto void php_rayaop_handle_error(const char *message)
-   Error handling function
+    intern->invocation = NULL;
+    zend_object_std_init(&intern->std, ce);
+    object_properties_init(&intern->std, ce);
+    intern->std.handlers = &php_rayaop_invocation_object_handlers;
+    return &intern->std;
+}
+/* }}} */
 
-   This function handles errors by outputting an error message.
+/* {{{ proto zend_function* php_rayaop_invocation_get_constructor(zend_object *object)
+   Constructor handler of Ray\Aop\NativeMethodInvocation and Ray\Aop\ArgumentView (instances are created by the extension only)
 
-   @param const char *message Error message to be displayed
+   @param zend_object *object The object
+   @return zend_function* Always NULL
 */
-void php_rayaop_handle_error(const char *message) {
-    php_error_docref(NULL, E_ERROR, "Memory error: %s", message); /* Output error message */
+static zend_function *php_rayaop_invocation_get_constructor(zend_object *object) {
+    zend_throw_error(NULL, "Cannot directly construct %s", ZSTR_VAL(object->ce->name));
+    return NULL;
 }
 /* }}} */
 
-/* {{{ proto bool php_rayaop_should_intercept(zend_execute_data *execute_data)
-   Function to determine if interception is necessary
-
-   This function checks if the current execution should be intercepted.
+/* {{{ proto void php_rayaop_invocation_object_init(zval *object, php_rayaop_invocation *invocation)
+   Function to create the Ray\Aop\NativeMethodInvocation passed to a native interceptor
 
-   @param zend_execute_data *execute_data Execution data
-   @return bool Returns true if interception is necessary, false otherwise
+   @param zval *object Receives the new object
+   @param php_rayaop_invocation *invocation The active invocation
 */
-bool php_rayaop_should_intercept(zend_execute_data *execute_data) {
-    return execute_data->func->common.scope && /* Scope exists */
-           execute_data->func->common.function_name && /* Function name exists */
-           !RAYAOP_G(is_intercepting); /* Not currently intercepting */
+void php_rayaop_invocation_object_init(zval *object, php_rayaop_invocation *invocation) {
+    object_init_ex(object, ray_aop_native_method_invocation_ce);
+    php_rayaop_invocation_from_obj(Z_OBJ_P(object))->invocation = invocation;
 }
 /* }}} */
 
-/* {{{ proto char* php_rayaop_generate_intercept_key(zend_string *class_name, zend_string *method_name, size_t *key_len)
-   Function to generate intercept key
+/* {{{ proto void php_rayaop_invocation_object_detach(zval *object)
+   Function to detach a Ray\Aop\NativeMethodInvocation from its (finished) invocation
 
-   This function creates a key in the format "class_name::method_name" for use in the intercept hash table.
+   The invocation lives on the C stack; an interceptor keeping the object gets an Error instead of
+   a dangling pointer.
 
-   @param zend_string *class_name The name of the class
-   @param zend_string *method_name The name of the method
-   @param size_t *key_len Pointer to store the length of the generated key
-   @return char* The generated key, which must be freed by the caller using efree()
-*/
-char *php_rayaop_generate_intercept_key(zend_string *class_name, zend_string *method_name, size_t *key_len) {
-    char *key = NULL;
-    *key_len = spprintf(&key, 0, "%s::%s", ZSTR_VAL(class_name), ZSTR_VAL(method_name));
-    /* Generate key in the format class_name::method_name */
-    PHP_RAYAOP_DEBUG_PRINT("Generated key: %s", key); /* Output generated key for debugging */
-    return key;
+   @param zval *object The invocation object
+*/
+void php_rayaop_invocation_object_detach(zval *object) {
+    php_rayaop_invocation_from_obj(Z_OBJ_P(object))->invocation = NULL;
 }
 /* }}} */
 
-/* {{{ proto php_rayaop_intercept_info* php_rayaop_find_intercept_info(const char *key, size_t key_len)
-   Function to search for intercept information
-
-   This function searches for intercept information in the hash table using the provided key.
+/* {{{ proto php_rayaop_invocation* php_rayaop_invocation_fetch(zend_execute_data *execute_data)
+   Function to get the active invocation of the called Ray\Aop\NativeMethodInvocation or Ray\Aop\ArgumentView
 
-   @param const char *key The key to search for
-   @param size_t key_len The length of the key
-   @return php_rayaop_intercept_info* Pointer to the intercept information if found, NULL otherwise
+   @param zend_execute_data *execute_data The execution data of the method call
+   @return php_rayaop_invocation* The invocation, NULL (with an Error thrown) if it has finished
 */
-php_rayaop_intercept_info *php_rayaop_find_intercept_info(const char *key, size_t key_len) {
-    return zend_hash_str_find_ptr(RAYAOP_G(intercept_ht), key, key_len);
-    /* Search for intercept information in hash table */
+static php_rayaop_invocation *php_rayaop_invocation_fetch(zend_execute_data *execute_data) {
+    php_rayaop_invocation *invocation = php_rayaop_invocation_from_obj(Z_OBJ(execute_data->This))->invocation;
+
+    if (!invocation) {
+        zend_throw_error(NULL, "The invocation of this %s has already finished", ZSTR_VAL(Z_OBJCE(execute_data->This)->name));
+    }
+    return invocation;
 }
 /* }}} */
 
-/* {{{ Helper function to prepare intercept parameters */
-static void prepare_intercept_params(zend_execute_data *execute_data, zval *params, php_rayaop_intercept_info *info) {
-    ZVAL_OBJ(&params[0], execute_data->This.value.obj);
-    ZVAL_STR(&params[1], info->method_name);
+/* {{{ proto mixed Ray\Aop\NativeMethodInvocation::proceed()
+   Method to execute the original method with the intercepted arguments
 
-    array_init(&params[2]);
-    uint32_t arg_count = ZEND_CALL_NUM_ARGS(execute_data);
-    zval *args = ZEND_CALL_ARG(execute_data, 1);
-    for (uint32_t i = 0; i < arg_count; i++) {
-        zval *arg = &args[i];
-        Z_TRY_ADDREF_P(arg);
-        add_next_index_zval(&params[2], arg);
+   @return mixed The result of the original method
+*/
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, proceed) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
+
+    php_rayaop_proceed(invocation, return_value);
+    if (Z_ISUNDEF_P(return_value)) {
+        ZVAL_NULL(return_value); /* Exception thrown by the original method */
     }
 }
 /* }}} */
 
-/* {{{ Helper function to call the intercept handler */
-static bool call_intercept_handler(zval *handler, zval *params, zval *retval) {
-    zval func_name;
-    ZVAL_STRING(&func_name, "intercept");
+/* {{{ proto ?object Ray\Aop\NativeMethodInvocation::getThis()
+   Method to get the object on which the method was called
 
-    bool success = (call_user_function(NULL, handler, &func_name, retval, 3, params) == SUCCESS);
+   @return ?object The object, or null for a static method or a function
+*/
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, getThis) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-    zval_ptr_dtor(&func_name);
-    return success;
-}
-/* }}} */
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
 
-/* {{{ Helper function to clean up after interception */
-static void cleanup_intercept(zval *params, zval *retval) {
-    zval_ptr_dtor(&params[1]);
-    zval_ptr_dtor(&params[2]);
-    zval_ptr_dtor(retval);
+    if (Z_TYPE(invocation->execute_data->This) != IS_OBJECT) {
+        RETURN_NULL(); /* Static method or function */
+    }
+    RETURN_OBJ_COPY(Z_OBJ(invocation->execute_data->This));
 }
 /* }}} */
 
-/* {{{ proto void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info)
-   Main function to execute method interception */
-void php_rayaop_execute_intercept(zend_execute_data *execute_data, php_rayaop_intercept_info *info) {
-    PHP_RAYAOP_DEBUG_PRINT("Executing intercept for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+/* {{{ proto ?string Ray\Aop\NativeMethodInvocation::getClassName()
+   Method to get the class on which the method was called
 
-    if (Z_TYPE(info->handler) != IS_OBJECT) {
-        PHP_RAYAOP_DEBUG_PRINT("Invalid handler, skipping interception");
-        return;
+   For a static method this is the class named in the call (static::), which may be a subclass of
+   the declaring class.
+
+   @return ?string The class name, or null for a function
+*/
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, getClassName) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
     }
 
-    if (execute_data->This.value.obj == NULL) {
-        PHP_RAYAOP_DEBUG_PRINT("Object is NULL, calling original function");
-        php_rayaop_original_execute_ex(execute_data);
-        return;
+    zend_execute_data *call = invocation->execute_data; /* The intercepted frame */
+    if (Z_TYPE(call->This) == IS_OBJECT) {
+        RETURN_STR_COPY(Z_OBJCE(call->This)->name);
+    }
+    if (!call->func->common.scope) {
+        RETURN_NULL(); /* Function */
     }
+    RETURN_STR_COPY(Z_CE(call->This) ? Z_CE(call->This)->name : call->func->common.scope->name);
+}
+/* }}} */
 
-    zval retval, params[3];
-    prepare_intercept_params(execute_data, params, info);
+/* {{{ proto string Ray\Aop\NativeMethodInvocation::getMethodName()
+   Method to get the name of the intercepted method
 
-    RAYAOP_G(is_intercepting) = 1;
+   @return string The method name
+*/
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, getMethodName) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-    ZVAL_UNDEF(&retval);
-    if (call_intercept_handler(&info->handler, params, &retval)) {
-        if (!Z_ISUNDEF(retval)) {
-            ZVAL_COPY(execute_data->return_value, &retval);
-        }
-    } else {
-        php_error_docref(NULL, E_WARNING, "Interception failed for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
     }
 
-    cleanup_intercept(params, &retval);
-    RAYAOP_G(is_intercepting) = 0;
+    RETURN_STR_COPY(invocation->info->method_name);
+}
+/* }}} */
 
-    PHP_RAYAOP_DEBUG_PRINT("Interception completed for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
+/* {{{ proto array Ray\Aop\NativeMethodInvocation::getArguments()
+   Method to get the arguments of the intercepted call
+
+   @return array The arguments (named arguments collected by a variadic parameter keep their names)
+*/
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, getArguments) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
+
+    php_rayaop_copy_frame_args(invocation->execute_data, return_value);
 }
 /* }}} */
 
-/* {{{ proto void php_rayaop_free_intercept_info(zval *zv)
-   Function to free intercept information
+/* {{{ proto Ray\Aop\ArgumentView Ray\Aop\NativeMethodInvocation::getArgumentView()
+   Method to get a read-only view of the arguments of the intercepted call
 
-   This function frees the memory allocated for intercept information.
+   Unlike getArguments(), the view does not copy the arguments: each access reads the call frame.
+   It is created once per invocation and shared by the interceptors of the chain.
 
-   @param zval *zv The zval containing the intercept information to be freed
+   @return Ray\Aop\ArgumentView The argument view
 */
-void php_rayaop_free_intercept_info(zval *zv) {
-    php_rayaop_intercept_info *info = Z_PTR_P(zv); /* Get intercept information pointer from zval */
-    if (info) {
-        /* If intercept information exists */
-        PHP_RAYAOP_DEBUG_PRINT("Freeing intercept info for %s::%s", ZSTR_VAL(info->class_name), ZSTR_VAL(info->method_name));
-        /* Output debug information */
-        zend_string_release(info->class_name); /* Free memory for class name */
-        zend_string_release(info->method_name); /* Free memory for method name */
-        zval_ptr_dtor(&info->handler); /* Free memory for handler */
-        efree(info); /* Free memory for intercept information structure */
+PHP_METHOD(Ray_Aop_NativeMethodInvocation, getArgumentView) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
+
+    if (Z_ISUNDEF(invocation->argument_view)) {
+        object_init_ex(&invocation->argument_view, ray_aop_argument_view_ce); /* Detached when the invocation ends */
+        php_rayaop_invocation_from_obj(Z_OBJ(invocation->argument_view))->invocation = invocation;
     }
+    RETURN_COPY(&invocation->argument_view);
 }
 /* }}} */
 
-/* {{{ proto void php_rayaop_execute_ex(zend_execute_data *execute_data)
-   Custom zend_execute_ex function
+/* {{{ proto zval* php_rayaop_find_argument(zend_execute_data *execute_data, zval *offset)
+   Function to find an argument of a frame by position or by parameter name
 
-   This function replaces the original zend_execute_ex function to implement method interception.
+   Only passed arguments are found; defaults of omitted parameters are not evaluated yet.
 
-   @param zend_execute_data *execute_data The execution data
+   @param zend_execute_data *execute_data The execution data of the intercepted call
+   @param zval *offset Zero-based position, or the name of a parameter or of a collected named argument
+   @return zval* The argument (may be a reference), NULL if it was not passed
 */
-static void php_rayaop_execute_ex(zend_execute_data *execute_data) {
-    PHP_RAYAOP_DEBUG_PRINT("php_rayaop_execute_ex called"); /* Output debug information */
+static zval *php_rayaop_find_argument(zend_execute_data *execute_data, zval *offset) {
+    uint32_t num_args = ZEND_CALL_NUM_ARGS(execute_data); /* Number of passed arguments */
+    zend_ulong position;
 
-    if (!php_rayaop_should_intercept(execute_data)) {
-        /* If interception is not necessary */
-        php_rayaop_original_execute_ex(execute_data); /* Call the original execution function */
-        return; /* End processing */
+    if (Z_TYPE_P(offset) == IS_LONG) {
+        if (Z_LVAL_P(offset) < 0) {
+            return NULL;
+        }
+        position = (zend_ulong) Z_LVAL_P(offset);
+    } else if (Z_TYPE_P(offset) != IS_STRING) {
+        return NULL;
+    } else if (!ZEND_HANDLE_NUMERIC_STR(Z_STRVAL_P(offset), Z_STRLEN_P(offset), position)) {
+        zend_function *func = execute_data->func;
+        uint32_t declared = MIN(num_args, func->common.num_args); /* Passed declared parameters */
+        for (uint32_t i = 0; i < declared; i++) {
+            bool found;
+            if (func->type == ZEND_INTERNAL_FUNCTION) {
+                const char *name = ((zend_internal_arg_info *) func->common.arg_info)[i].name; /* Internal parameter name */
+                found = (strlen(name) == Z_STRLEN_P(offset) && memcmp(name, Z_STRVAL_P(offset), Z_STRLEN_P(offset)) == 0);
+            } else {
+                found = zend_string_equals(func->op_array.arg_info[i].name, Z_STR_P(offset));
+            }
+            if (found) {
+                return php_rayaop_frame_arg(execute_data, i); /* Declared parameter */
+            }
+        }
+        if (ZEND_CALL_INFO(execute_data) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS) {
+            return zend_hash_find(execute_data->extra_named_params, Z_STR_P(offset)); /* Collected named argument */
+        }
+        return NULL;
     }
 
-    zend_function *current_function = execute_data->func; /* Get current function information */
-    zend_string *class_name = current_function->common.scope->name; /* Get class name */
-    zend_string *method_name = current_function->common.function_name; /* Get method name */
+    return position < num_args ? php_rayaop_frame_arg(execute_data, (uint32_t) position) : NULL;
+}
+/* }}} */
 
-    size_t key_len;
-    char *key = php_rayaop_generate_intercept_key(class_name, method_name, &key_len); /* Generate intercept key */
+/* {{{ proto bool Ray\Aop\ArgumentView::offsetExists(mixed $offset)
+   Method to check whether an argument was passed
 
-    php_rayaop_intercept_info *info = php_rayaop_find_intercept_info(key, key_len); /* Search for intercept information */
+   @param mixed offset Position or parameter name
+   @return bool Whether the argument was passed (and is not null)
+*/
+PHP_METHOD(Ray_Aop_ArgumentView, offsetExists) {
+    zval *offset;
 
-    if (info) {
-        /* If intercept information is found */
-        PHP_RAYAOP_DEBUG_PRINT("Found intercept info for key: %s", key); /* Output debug information */
-        php_rayaop_execute_intercept(execute_data, info); /* Execute interception */
-    } else {
-        /* If intercept information is not found */
-        PHP_RAYAOP_DEBUG_PRINT("No intercept info found for key: %s", key); /* Output debug information */
-        php_rayaop_original_execute_ex(execute_data); /* Call the original execution function */
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
     }
 
-    efree(key); /* Free memory for key */
+    zval *arg = php_rayaop_find_argument(invocation->execute_data, offset);
+    if (arg) {
+        ZVAL_DEREF(arg);
+    }
+    RETURN_BOOL(arg && Z_TYPE_P(arg) != IS_NULL);
 }
 /* }}} */
 
-/* {{{ proto void php_rayaop_hash_update_failed(php_rayaop_intercept_info *new_info, char *key)
-   Handling for hash table update failure
-
-   This function handles the case when updating the intercept hash table fails.
+/* {{{ proto mixed Ray\Aop\ArgumentView::offsetGet(mixed $offset)
+   Method to read an argument
 
-   @param php_rayaop_intercept_info *new_info The new intercept information that failed to be added
-   @param char *key The key that was used for the failed update
+   @param mixed offset Position or parameter name
+   @return mixed The argument, null if it was not passed
 */
-void php_rayaop_hash_update_failed(php_rayaop_intercept_info *new_info, char *key) {
-    php_rayaop_handle_error("Failed to update intercept hash table"); /* Output error message */
-    zend_string_release(new_info->class_name); /* Free memory for class name */
-    zend_string_release(new_info->method_name); /* Free memory for method name */
-    zval_ptr_dtor(&new_info->handler); /* Free memory for handler */
-    efree(new_info); /* Free memory for intercept information structure */
-    efree(key); /* Free memory for key */
+PHP_METHOD(Ray_Aop_ArgumentView, offsetGet) {
+    zval *offset;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
+
+    zval *arg = php_rayaop_find_argument(invocation->execute_data, offset);
+    if (arg) {
+        RETURN_COPY_DEREF(arg);
+    }
+    RETURN_NULL();
 }
 /* }}} */
 
-/* {{{ proto bool method_intercept(string class_name, string method_name, object intercepted)
-   Function to register intercept method
+/* {{{ proto void Ray\Aop\ArgumentView::offsetSet(mixed $offset, mixed $value)
+   Method rejecting writes (the view is read-only)
+*/
+PHP_METHOD(Ray_Aop_ArgumentView, offsetSet) {
+    zval *offset, *value;
 
-   This function registers an interceptor for a specified class method.
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_ZVAL(offset)
+        Z_PARAM_ZVAL(value)
+    ZEND_PARSE_PARAMETERS_END();
 
-   @param string class_name The name of the class
-   @param string method_name The name of the method
-   @param object intercepted The interceptor object
-   @return bool Returns TRUE on success or FALSE on failure
-*/
-PHP_FUNCTION(method_intercept) {
-    PHP_RAYAOP_DEBUG_PRINT("method_intercept called"); /* Output debug information */
+    zend_throw_error(NULL, "Ray\\Aop\\ArgumentView is read-only");
+}
+/* }}} */
 
-    char *class_name, *method_name; /* Pointers for class name and method name */
-    size_t class_name_len, method_name_len; /* Lengths of class name and method name */
-    zval *intercepted; /* Intercept handler */
+/* {{{ proto void Ray\Aop\ArgumentView::offsetUnset(mixed $offset)
+   Method rejecting writes (the view is read-only)
+*/
+PHP_METHOD(Ray_Aop_ArgumentView, offsetUnset) {
+    zval *offset;
 
-    ZEND_PARSE_PARAMETERS_START(3, 3)
-        Z_PARAM_STRING(class_name, class_name_len) /* Parse class name parameter */
-        Z_PARAM_STRING(method_name, method_name_len) /* Parse method name parameter */
-        Z_PARAM_OBJECT(intercepted) /* Parse intercept handler parameter */
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ZVAL(offset)
     ZEND_PARSE_PARAMETERS_END();
 
-    php_rayaop_intercept_info *new_info = ecalloc(1, sizeof(php_rayaop_intercept_info)); /* Allocate memory for new intercept information */
-    if (!new_info) {
-        /* If memory allocation fails */
-        php_rayaop_handle_error("Failed to allocate memory for intercept_info"); /* Output error message */
-        RETURN_FALSE; /* Return false and end */
+    zend_throw_error(NULL, "Ray\\Aop\\ArgumentView is read-only");
+}
+/* }}} */
+
+/* {{{ proto int Ray\Aop\ArgumentView::count()
+   Method to count the passed arguments
+
+   @return int Number of positional and collected named arguments
+*/
+PHP_METHOD(Ray_Aop_ArgumentView, count) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
+    }
+
+    zend_execute_data *intercepted = invocation->execute_data;
+    zend_long count = ZEND_CALL_NUM_ARGS(intercepted);
+    if (ZEND_CALL_INFO(intercepted) & ZEND_CALL_HAS_EXTRA_NAMED_PARAMS) {
+        count += zend_hash_num_elements(intercepted->extra_named_params);
     }
+    RETURN_LONG(count);
+}
+/* }}} */
 
-    new_info->class_name = zend_string_init(class_name, class_name_len, 0); /* Initialize class name */
-    new_info->method_name = zend_string_init(method_name, method_name_len, 0); /* Initialize method name */
-    ZVAL_COPY(&new_info->handler, intercepted); /* Copy intercept handler */
+/* {{{ proto array Ray\Aop\ArgumentView::toArray()
+   Method to materialize the arguments (same as NativeMethodInvocation::getArguments())
 
-    char *key = NULL;
-    size_t key_len = spprintf(&key, 0, "%s::%s", class_name, method_name); /* Generate intercept key */
+   @return array The arguments
+*/
+PHP_METHOD(Ray_Aop_ArgumentView, toArray) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-    if (zend_hash_str_update_ptr(RAYAOP_G(intercept_ht), key, key_len, new_info) == NULL) {
-        /* Add to hash table */
-        php_rayaop_hash_update_failed(new_info, key); /* Execute error handling if addition fails */
-RETURN_FALSE; /* Return false and end */
+    php_rayaop_invocation *invocation = php_rayaop_invocation_fetch(execute_data);
+    if (!invocation) {
+        RETURN_THROWS();
     }
 
-    efree(key); /* Free memory for key */
-    PHP_RAYAOP_DEBUG_PRINT("Successfully registered intercept info"); /* Output debug information */
-    RETURN_TRUE; /* Return true and end */
+    php_rayaop_copy_frame_args(invocation->execute_data, return_value);
 }
 /* }}} */
 
-/* Interface definition */
-zend_class_entry *ray_aop_method_interceptor_interface_ce;
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_offsetExists, 0, 1, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, offset, IS_MIXED, 0)
+ZEND_END_ARG_INFO()
 
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_method_interceptor_intercept, 0, 3, IS_MIXED, 0)
-    ZEND_ARG_TYPE_INFO(0, object, IS_OBJECT, 0) /* 1st argument: object */
-    ZEND_ARG_TYPE_INFO(0, method, IS_STRING, 0) /* 2nd argument: method name */
-    ZEND_ARG_TYPE_INFO(0, params, IS_ARRAY, 0) /* 3rd argument: parameter array */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_offsetGet, 0, 1, IS_MIXED, 0)
+    ZEND_ARG_TYPE_INFO(0, offset, IS_MIXED, 0)
 ZEND_END_ARG_INFO()
 
-static const zend_function_entry ray_aop_method_interceptor_interface_methods[] = {
-    ZEND_ABSTRACT_ME(Ray_Aop_MethodInterceptorInterface, intercept, arginfo_ray_aop_method_interceptor_intercept)
-    /* Define intercept method */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_offsetSet, 0, 2, IS_VOID, 0)
+    ZEND_ARG_TYPE_INFO(0, offset, IS_MIXED, 0)
+    ZEND_ARG_TYPE_INFO(0, value, IS_MIXED, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_offsetUnset, 0, 1, IS_VOID, 0)
+    ZEND_ARG_TYPE_INFO(0, offset, IS_MIXED, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_count, 0, 0, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_argument_view_toArray, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry ray_aop_argument_view_methods[] = {
+    PHP_ME(Ray_Aop_ArgumentView, offsetExists, arginfo_ray_aop_argument_view_offsetExists, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_ArgumentView, offsetGet, arginfo_ray_aop_argument_view_offsetGet, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_ArgumentView, offsetSet, arginfo_ray_aop_argument_view_offsetSet, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_ArgumentView, offsetUnset, arginfo_ray_aop_argument_view_offsetUnset, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_ArgumentView, count, arginfo_ray_aop_argument_view_count, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_ArgumentView, toArray, arginfo_ray_aop_argument_view_toArray, ZEND_ACC_PUBLIC)
+    PHP_FE_END /* End of function entries */
+};
+
+ZEND_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_ray_aop_native_method_invocation_getArgumentView, 0, 0, Ray\\Aop\\ArgumentView, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_invocation_proceed, 0, 0, IS_MIXED, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_invocation_getThis, 0, 0, IS_OBJECT, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_invocation_getClassName, 0, 0, IS_STRING, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_invocation_getMethodName, 0, 0, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_ray_aop_native_method_invocation_getArguments, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry ray_aop_native_method_invocation_methods[] = {
+    PHP_ME(Ray_Aop_NativeMethodInvocation, proceed, arginfo_ray_aop_native_method_invocation_proceed, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_NativeMethodInvocation, getThis, arginfo_ray_aop_native_method_invocation_getThis, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_NativeMethodInvocation, getClassName, arginfo_ray_aop_native_method_invocation_getClassName, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_NativeMethodInvocation, getMethodName, arginfo_ray_aop_native_method_invocation_getMethodName, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_NativeMethodInvocation, getArguments, arginfo_ray_aop_native_method_invocation_getArguments, ZEND_ACC_PUBLIC)
+    PHP_ME(Ray_Aop_NativeMethodInvocation, getArgumentView, arginfo_ray_aop_native_method_invocation_getArgumentView, ZEND_ACC_PUBLIC)
     PHP_FE_END /* End of function entries */
 };
 
@@ -333,7 +4072,7 @@ PHP_MINIT_FUNCTION(rayaop) {
     PHP_RAYAOP_DEBUG_PRINT("PHP_MINIT_FUNCTION called"); /* Output debug information */
 
 #ifdef ZTS
-    ts_allocate_id(&rayaop_globals_id, sizeof(zend_rayaop_globals), (ts_allocate_ctor) php_rayaop_init_globals, NULL);  /* Initialize global variables in thread-safe mode */
+    ts_allocate_id(&rayaop_globals_id, sizeof(zend_rayaop_globals), (ts_allocate_ctor) php_rayaop_init_globals, (ts_allocate_dtor) php_rayaop_shutdown_globals);  /* Initialize global variables in thread-safe mode */
 #else
     php_rayaop_init_globals(&rayaop_globals); /* Initialize global variables in non-thread-safe mode */
 #endif
@@ -347,8 +4086,82 @@ PHP_MINIT_FUNCTION(rayaop) {
     /* Initialize class entry */
     ray_aop_method_interceptor_interface_ce = zend_register_internal_interface(&ce); /* Register interface */
 
+    INIT_CLASS_ENTRY(ce, "Ray\\Aop\\NativeMethodInterceptorInterface", ray_aop_native_method_interceptor_interface_methods);
+    ray_aop_native_method_interceptor_interface_ce = zend_register_internal_interface(&ce); /* Register native interceptor interface */
+
+    INIT_CLASS_ENTRY(ce, "Ray\\Aop\\NativeMethodInvocation", ray_aop_native_method_invocation_methods);
+    ray_aop_native_method_invocation_ce = zend_register_internal_class_ex(&ce, NULL); /* Register invocation class */
+    ray_aop_native_method_invocation_ce->ce_flags |= ZEND_ACC_FINAL | ZEND_ACC_NO_DYNAMIC_PROPERTIES | ZEND_ACC_NOT_SERIALIZABLE;
+    ray_aop_native_method_invocation_ce->create_object = php_rayaop_invocation_create_object;
+    memcpy(&php_rayaop_invocation_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    php_rayaop_invocation_object_handlers.offset = XtOffsetOf(php_rayaop_invocation_object, std);
+    php_rayaop_invocation_object_handlers.get_constructor = php_rayaop_invocation_get_constructor;
+    php_rayaop_invocation_object_handlers.clone_obj = NULL; /* Bound to a single call */
+
+    INIT_CLASS_ENTRY(ce, "Ray\\Aop\\ArgumentView", ray_aop_argument_view_methods);
+    ray_aop_argument_view_ce = zend_register_internal_class_ex(&ce, NULL); /* Register argument view class */
+    ray_aop_argument_view_ce->ce_flags |= ZEND_ACC_FINAL | ZEND_ACC_NO_DYNAMIC_PROPERTIES | ZEND_ACC_NOT_SERIALIZABLE;
+    ray_aop_argument_view_ce->create_object = php_rayaop_invocation_create_object; /* Same layout as the invocation */
+    zend_class_implements(ray_aop_argument_view_ce, 2, zend_ce_arrayaccess, zend_ce_countable);
+
+    php_rayaop_cache_generation_handle = zend_get_op_array_extension_handle("rayaop"); /* Reserve run-time cache slot for the generation */
+    php_rayaop_cache_info_handle = zend_get_op_array_extension_handle("rayaop"); /* Reserve run-time cache slot for the binding */
+    php_rayaop_cache_observed_handle = zend_get_op_array_extension_handle("rayaop"); /* Reserve run-time cache slot for the observer state */
+    php_rayaop_fiber_handle = zend_get_resource_handle("rayaop"); /* Reserve fiber context slot for the invocation stack */
+    php_rayaop_weakmap_ce = zend_hash_str_find_ptr(CG(class_table), "weakmap", sizeof("weakmap") - 1); /* Holds per-object bindings */
+    php_rayaop_le_instance_bindings = zend_register_list_destructors_ex(php_rayaop_free_instance_bindings, NULL, "rayaop instance bindings", module_number);
+    if (php_rayaop_fiber_handle >= 0) {
+        zend_observer_fiber_init_register(php_rayaop_fiber_init); /* Start new fibers with an empty invocation stack */
+        zend_observer_fiber_switch_register(php_rayaop_fiber_switch); /* Swap invocation stacks on fiber switches */
+    }
+
+    REGISTER_INI_ENTRIES(); /* Register INI entries */
+
+#ifdef ZTS
+    php_rayaop_registry_mutex = tsrm_mutex_alloc(); /* Serializes registry writers */
+#endif
+    if ((RAYAOP_G(registry_file) && *RAYAOP_G(registry_file)) || (RAYAOP_G(bindings) && *RAYAOP_G(bindings))) {
+        php_rayaop_registry *registry = php_rayaop_registry_alloc(NULL); /* Built once, shared by all threads */
+        if (RAYAOP_G(registry_file) && *RAYAOP_G(registry_file)) {
+            php_rayaop_registry_load_file(registry, RAYAOP_G(registry_file));
+        }
+        if (RAYAOP_G(bindings) && *RAYAOP_G(bindings)) {
+            php_rayaop_registry_load(registry, RAYAOP_G(bindings)); /* Listed bindings take precedence over the image */
+        }
+        PHP_RAYAOP_ATOMIC_STORE_PTR(&php_rayaop_registry_current, registry); /* Publish */
+    }
+
     php_rayaop_original_execute_ex = zend_execute_ex; /* Save the original zend_execute_ex function */
-    zend_execute_ex = php_rayaop_execute_ex; /* Set the custom zend_execute_ex function */
+    if (RAYAOP_G(backend) && strcmp(RAYAOP_G(backend), "observer") == 0) {
+        /* Observer backend: the VM keeps executing calls inline (and JIT stays enabled) */
+        php_rayaop_backend = PHP_RAYAOP_BACKEND_OBSERVER;
+        zend_observer_fcall_register(php_rayaop_observer_init); /* Attach begin handlers to intercepted functions only */
+        php_rayaop_original_interrupt_function = zend_interrupt_function; /* Save the original interrupt function */
+        zend_interrupt_function = php_rayaop_interrupt_function; /* Set the custom interrupt function */
+    } else {
+        php_rayaop_backend = PHP_RAYAOP_BACKEND_EXECUTE_EX;
+        zend_execute_ex = php_rayaop_execute_ex; /* Set the custom zend_execute_ex function */
+    }
+    if (RAYAOP_G(intercept_internal)) {
+        /* Internal methods are only visible through zend_execute_internal */
+        php_rayaop_original_execute_internal = zend_execute_internal; /* Save the original zend_execute_internal function */
+        zend_execute_internal = php_rayaop_execute_internal; /* Set the custom zend_execute_internal function */
+    }
+    /* Installed until the first request even with rayaop.lazy, so opcache sees the hooks at startup (and keeps JIT off) */
+    php_rayaop_hooks_installed = true;
+#ifdef ZTS
+    if (RAYAOP_G(lazy)) {
+        zend_error(E_CORE_WARNING, "rayaop.lazy is not supported by thread-safe builds, the execution hooks stay installed");
+    }
+#else
+    if (RAYAOP_G(lazy) && (php_rayaop_backend == PHP_RAYAOP_BACKEND_EXECUTE_EX || RAYAOP_G(intercept_internal))) {
+        /* Compile with the hooks installed while they are removed (see php_rayaop_compile_file()) */
+        php_rayaop_original_compile_file = zend_compile_file;
+        zend_compile_file = php_rayaop_compile_file;
+        php_rayaop_original_compile_string = zend_compile_string;
+        zend_compile_string = php_rayaop_compile_string;
+    }
+#endif
 
     PHP_RAYAOP_DEBUG_PRINT("RayAOP extension initialized"); /* Output debug information */
     return SUCCESS; /* Return success */
@@ -365,8 +4178,33 @@ PHP_MINIT_FUNCTION(rayaop) {
 */
 PHP_MSHUTDOWN_FUNCTION(rayaop) {
     PHP_RAYAOP_DEBUG_PRINT("RayAOP PHP_MSHUTDOWN_FUNCTION called"); /* Output debug information */
-    zend_execute_ex = php_rayaop_original_execute_ex; /* Restore the original zend_execute_ex function */
+    if (php_rayaop_backend == PHP_RAYAOP_BACKEND_OBSERVER) {
+        zend_interrupt_function = php_rayaop_original_interrupt_function; /* Restore the original interrupt function */
+        php_rayaop_original_interrupt_function = NULL; /* Clear the saved pointer */
+    } else {
+        zend_execute_ex = php_rayaop_original_execute_ex; /* Restore the original zend_execute_ex function */
+    }
     php_rayaop_original_execute_ex = NULL; /* Clear the saved pointer */
+    if (zend_execute_internal == php_rayaop_execute_internal) {
+        zend_execute_internal = php_rayaop_original_execute_internal; /* Restore the original zend_execute_internal function */
+        php_rayaop_original_execute_internal = NULL; /* Clear the saved pointer */
+    }
+#ifndef ZTS
+    if (zend_compile_file == php_rayaop_compile_file) {
+        zend_compile_file = php_rayaop_original_compile_file; /* Restore the original compiler function */
+    }
+    if (zend_compile_string == php_rayaop_compile_string) {
+        zend_compile_string = php_rayaop_original_compile_string; /* Restore the original compiler function */
+    }
+#endif
+    UNREGISTER_INI_ENTRIES(); /* Unregister INI entries */
+#ifndef ZTS
+    php_rayaop_shutdown_globals(&rayaop_globals); /* Free the statistics in non-thread-safe mode */
+#endif
+    php_rayaop_registry_free(); /* Free the process-wide registry */
+#ifdef ZTS
+    tsrm_mutex_free(php_rayaop_registry_mutex);
+#endif
     PHP_RAYAOP_DEBUG_PRINT("RayAOP PHP_MSHUTDOWN_FUNCTION shut down"); /* Output debug information */
     return SUCCESS; /* Return shutdown success */
 }
@@ -385,9 +4223,51 @@ PHP_RINIT_FUNCTION(rayaop) {
     if (RAYAOP_G(intercept_ht) == NULL) {
         /* If intercept hash table is not initialized */
         ALLOC_HASHTABLE(RAYAOP_G(intercept_ht)); /* Allocate memory for hash table */
-        zend_hash_init(RAYAOP_G(intercept_ht), 8, NULL, php_rayaop_free_intercept_info, 0); /* Initialize hash table */
+        zend_hash_init(RAYAOP_G(intercept_ht), RAYAOP_G(intercept_size_hint), NULL, php_rayaop_free_intercept_info, 0); /* Initialize hash table, sized like the previous request */
+    }
+    if (RAYAOP_G(intercept_classes) == NULL) {
+        /* If intercepted class table is not initialized */
+        ALLOC_HASHTABLE(RAYAOP_G(intercept_classes)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(intercept_classes), 8, NULL, NULL, 0); /* Initialize hash table */
+    }
+    if (RAYAOP_G(persistent_handlers) == NULL) {
+        /* If request cache of persistent interceptors is not initialized */
+        ALLOC_HASHTABLE(RAYAOP_G(persistent_handlers)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(persistent_handlers), 8, NULL, ZVAL_PTR_DTOR, 0); /* Initialize hash table */
+    }
+    if (RAYAOP_G(matchers) == NULL) {
+        /* If matcher list is not initialized */
+        ALLOC_HASHTABLE(RAYAOP_G(matchers)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(matchers), 8, NULL, php_rayaop_free_matcher, 0); /* Initialize hash table */
+        ALLOC_HASHTABLE(RAYAOP_G(matched_classes)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(matched_classes), 8, NULL, NULL, 0); /* Initialize hash table */
+    }
+    if (RAYAOP_G(instance_methods) == NULL) {
+        /* If table of methods bound on objects is not initialized */
+        ALLOC_HASHTABLE(RAYAOP_G(instance_methods)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(instance_methods), 8, NULL, NULL, 0); /* Initialize hash table */
     }
-    RAYAOP_G(is_intercepting) = 0; /* Initialize intercept flag */
+    if (RAYAOP_G(memos) == NULL) {
+        /* If memoization result cache list is not initialized */
+        ALLOC_HASHTABLE(RAYAOP_G(memos)); /* Allocate memory for hash table */
+        zend_hash_init(RAYAOP_G(memos), 8, NULL, php_rayaop_free_memo, 0); /* Initialize hash table */
+    }
+    RAYAOP_G(invocation) = NULL; /* Initialize active invocation stack */
+    RAYAOP_G(pending_return) = NULL; /* Initialize pending observer redirection */
+    RAYAOP_G(generation)++; /* Never reuse cached lookups of a previous request */
+    RAYAOP_G(batch_depth) = 0; /* A batch interrupted by a fatal error is over */
+    RAYAOP_G(enabled) = 1; /* Interception is enabled at the start of every request */
+    php_rayaop_registry_attach(); /* See persistent bindings published since the last request */
+#ifndef ZTS
+    if (RAYAOP_G(lazy) && php_rayaop_backend == PHP_RAYAOP_BACKEND_EXECUTE_EX) {
+        /* Compile method calls to ZEND_DO_FCALL even while the hook is removed: ZEND_DO_UCALL enters
+           the VM directly, so code compiled (and cached by opcache) in an idle request would bypass
+           a hook installed later. This also gives up compile-time function resolution, which is
+           why rayaop.lazy is opt-in */
+        CG(compiler_options) |= ZEND_COMPILE_IGNORE_USER_FUNCTIONS;
+    }
+#endif
+    php_rayaop_update_hooks(); /* Remove the hooks unless persistent bindings exist */
     return SUCCESS; /* Return success */
 }
 /* }}} */
@@ -402,12 +4282,65 @@ PHP_RINIT_FUNCTION(rayaop) {
 */
 PHP_RSHUTDOWN_FUNCTION(rayaop) {
     PHP_RAYAOP_DEBUG_PRINT("RayAOP PHP_RSHUTDOWN_FUNCTION called"); /* Output debug information */
+    if (Z_TYPE(RAYAOP_G(instances)) == IS_OBJECT) {
+        /* If per-object bindings exist (first: freeing them updates the tables below) */
+        zval_ptr_dtor(&RAYAOP_G(instances)); /* Release the WeakMap and every binding table */
+        ZVAL_UNDEF(&RAYAOP_G(instances));
+    }
+    if (RAYAOP_G(instance_methods)) {
+        /* If table of methods bound on objects exists */
+        zend_hash_destroy(RAYAOP_G(instance_methods)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(instance_methods)); /* Free memory for hash table */
+        RAYAOP_G(instance_methods) = NULL; /* Set hash table pointer to NULL */
+    }
     if (RAYAOP_G(intercept_ht)) {
         /* If intercept hash table exists */
+        RAYAOP_G(intercept_size_hint) = MAX(zend_hash_num_elements(RAYAOP_G(intercept_ht)), 8); /* Requests of a process tend to bind the same methods */
         zend_hash_destroy(RAYAOP_G(intercept_ht)); /* Destroy hash table */
         FREE_HASHTABLE(RAYAOP_G(intercept_ht)); /* Free memory for hash table */
         RAYAOP_G(intercept_ht) = NULL; /* Set hash table pointer to NULL */
     }
+    if (RAYAOP_G(intercept_classes)) {
+        /* If intercepted class table exists */
+        zend_hash_destroy(RAYAOP_G(intercept_classes)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(intercept_classes)); /* Free memory for hash table */
+        RAYAOP_G(intercept_classes) = NULL; /* Set hash table pointer to NULL */
+    }
+    if (RAYAOP_G(persistent_handlers)) {
+        /* If request cache of persistent interceptors exists */
+        zend_hash_destroy(RAYAOP_G(persistent_handlers)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(persistent_handlers)); /* Free memory for hash table */
+        RAYAOP_G(persistent_handlers) = NULL; /* Set hash table pointer to NULL */
+    }
+    if (RAYAOP_G(matchers)) {
+        /* If matcher list exists */
+        zend_hash_destroy(RAYAOP_G(matchers)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(matchers)); /* Free memory for hash table */
+        RAYAOP_G(matchers) = NULL; /* Set hash table pointer to NULL */
+        zend_hash_destroy(RAYAOP_G(matched_classes)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(matched_classes)); /* Free memory for hash table */
+        RAYAOP_G(matched_classes) = NULL; /* Set hash table pointer to NULL */
+    }
+    if (RAYAOP_G(memos)) {
+        /* If memoization result cache list exists (after the registry, which points to the caches) */
+        zend_hash_destroy(RAYAOP_G(memos)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(memos)); /* Free memory for hash table */
+        RAYAOP_G(memos) = NULL; /* Set hash table pointer to NULL */
+    }
+    if (RAYAOP_G(internal_cache)) {
+        /* If internal function lookup cache exists */
+        zend_hash_destroy(RAYAOP_G(internal_cache)); /* Destroy hash table */
+        FREE_HASHTABLE(RAYAOP_G(internal_cache)); /* Free memory for hash table */
+        RAYAOP_G(internal_cache) = NULL; /* Set hash table pointer to NULL */
+    }
+    if (RAYAOP_G(arena)) {
+        /* If binding arena exists (after the registry, which released all chains into it) */
+        zend_arena_destroy(RAYAOP_G(arena)); /* Free all chunks at once */
+        RAYAOP_G(arena) = NULL; /* Set arena pointer to NULL */
+        memset(RAYAOP_G(free_infos), 0, sizeof(RAYAOP_G(free_infos))); /* The released chains were part of the arena */
+    }
+    php_rayaop_update_hooks(); /* Remove the hooks unless persistent bindings exist */
+    php_rayaop_registry_detach(); /* Publish the persistent bindings of the request (ZTS) */
     PHP_RAYAOP_DEBUG_PRINT("RayAOP PHP_RSHUTDOWN_FUNCTION shut down"); /* Output debug information */
     return SUCCESS; /* Return shutdown success */
 }
@@ -422,7 +4355,33 @@ PHP_MINFO_FUNCTION(rayaop) {
     php_info_print_table_start(); /* Start information table */
     php_info_print_table_header(2, "rayaop support", "enabled"); /* Display table header */
     php_info_print_table_row(2, "Version", PHP_RAYAOP_VERSION); /* Display version information */
+    char count[32];
+    snprintf(count, sizeof(count), "%u", RAYAOP_G(persistent_ht) ? zend_hash_num_elements(RAYAOP_G(persistent_ht)) : 0);
+    php_info_print_table_row(2, "Persistent bindings", count); /* Display persistent registry size */
+    php_info_print_table_row(2, "Backend", php_rayaop_backend == PHP_RAYAOP_BACKEND_OBSERVER ? "observer" : "execute_ex"); /* Display active backend */
+    php_info_print_table_row(2, "Execution hooks", php_rayaop_hooks_installed ? "installed" : "idle"); /* Display hook state */
+    php_info_print_table_row(2, "Statistics", RAYAOP_G(stats) ? "enabled" : "disabled"); /* Display statistics state */
+    if (RAYAOP_G(stats_ht)) {
+        zend_ulong calls = 0; /* Intercepted calls of all bindings */
+        php_rayaop_binding_stats *stats;
+        ZEND_HASH_FOREACH_PTR(RAYAOP_G(stats_ht), stats) {
+            calls += stats->calls;
+        } ZEND_HASH_FOREACH_END();
+
+        char buf[32];
+        snprintf(buf, sizeof(buf), ZEND_ULONG_FMT, calls);
+        php_info_print_table_row(2, "Intercepted calls", buf); /* Display intercepted calls */
+        snprintf(buf, sizeof(buf), "%u", zend_hash_num_elements(RAYAOP_G(stats_ht)));
+        php_info_print_table_row(2, "Bindings with statistics", buf); /* Display number of bindings */
+    }
+    if (RAYAOP_G(stats)) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), ZEND_ULONG_FMT, RAYAOP_G(stats_rejected));
+        php_info_print_table_row(2, "Calls rejected on the fast path", buf); /* Display rejected calls */
+    }
     php_info_print_table_end(); /* End information table */
+
+    DISPLAY_INI_ENTRIES(); /* Display INI entries */
 }
 /* }}} */
 
@@ -443,7 +4402,7 @@ static void php_rayaop_dump_intercept_info(void)
                 PHP_RAYAOP_DEBUG_PRINT("Key: %s", ZSTR_VAL(key));  /* Output key */
                 PHP_RAYAOP_DEBUG_PRINT("  Class: %s", ZSTR_VAL(info->class_name));  /* Output class name */
                 PHP_RAYAOP_DEBUG_PRINT("  Method: %s", ZSTR_VAL(info->method_name));  /* Output method name */
-                PHP_RAYAOP_DEBUG_PRINT("  Handler type: %d", Z_TYPE(info->handler));  /* Output handler type */
+                PHP_RAYAOP_DEBUG_PRINT("  Handlers: %u", info->handler_count);  /* Output chain length */
             }
         } ZEND_HASH_FOREACH_END();
     } else {  /* If intercept hash table does not exist */
@@ -456,6 +4415,21 @@ static void php_rayaop_dump_intercept_info(void)
 /* Definition of functions provided by the extension */
 static const zend_function_entry rayaop_functions[] = {
     PHP_FE(method_intercept, arginfo_method_intercept) /* Register method_intercept function */
+    PHP_FE(method_intercept_append, arginfo_method_intercept) /* Register method_intercept_append function */
+    PHP_FE(method_intercept_prepend, arginfo_method_intercept) /* Register method_intercept_prepend function */
+    PHP_FE(method_intercept_remove, arginfo_method_intercept) /* Register method_intercept_remove function */
+    PHP_FE(method_intercept_many, arginfo_method_intercept_many) /* Register method_intercept_many function */
+    PHP_FE(method_intercept_sample, arginfo_method_intercept_sample) /* Register method_intercept_sample function */
+    PHP_FE(function_intercept, arginfo_function_intercept) /* Register function_intercept function */
+    PHP_FE(method_intercept_object, arginfo_method_intercept_object) /* Register method_intercept_object function */
+    PHP_FE(method_intercept_object_remove, arginfo_method_intercept_object) /* Register method_intercept_object_remove function */
+    PHP_FE(method_intercept_match, arginfo_method_intercept_match) /* Register method_intercept_match function */
+    PHP_FE(method_intercept_persistent, arginfo_method_intercept_persistent) /* Register method_intercept_persistent function */
+    PHP_FE(rayaop_registry_export, arginfo_rayaop_registry_export) /* Register rayaop_registry_export function */
+    PHP_FE(method_memoize, arginfo_method_memoize) /* Register method_memoize function */
+    PHP_FE(rayaop_stats, arginfo_rayaop_stats) /* Register rayaop_stats function */
+    PHP_FE(rayaop_enable, arginfo_rayaop_enable) /* Register rayaop_enable function */
+    PHP_FE(rayaop_disable, arginfo_rayaop_enable) /* Register rayaop_disable function */
     PHP_FE_END /* End of function entries */
 };
 
@@ -0,0 +1,46 @@
+--TEST--
+RayAOP cached binding is invalidated on registration
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+}
+
+class Interceptor1 implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Interceptor1: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+class Interceptor2 implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Interceptor2: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+$test = new TestClass();
+
+// Cache a negative lookup before any binding exists
+var_dump($test->testMethod("Hello"));
+var_dump($test->testMethod("Hello"));
+
+method_intercept(TestClass::class, 'testMethod', new Interceptor1());
+var_dump($test->testMethod("Hello"));
+var_dump($test->testMethod("Hello"));
+
+method_intercept(TestClass::class, 'testMethod', new Interceptor2());
+var_dump($test->testMethod("Hello"));
+
+?>
+--EXPECT--
+string(15) "Original: Hello"
+string(15) "Original: Hello"
+string(29) "Interceptor1: Original: Hello"
+string(29) "Interceptor1: Original: Hello"
+string(29) "Interceptor2: Original: Hello"
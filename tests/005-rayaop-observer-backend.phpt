@@ -0,0 +1,41 @@
+--TEST--
+RayAOP observer backend
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.backend=observer
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function otherMethod($arg) {
+        return "Other: " . $arg;
+    }
+}
+
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Intercepted: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+var_dump(ini_get('rayaop.backend'));
+method_intercept(TestClass::class, 'testMethod', new TestInterceptor());
+
+$test = new TestClass();
+var_dump($test->testMethod("Hello"));
+var_dump($test->testMethod("World"));
+var_dump($test->otherMethod("Hello"));
+$test->testMethod("Unused result");
+
+?>
+--EXPECT--
+string(8) "observer"
+string(28) "Intercepted: Original: Hello"
+string(28) "Intercepted: Original: World"
+string(12) "Other: Hello"
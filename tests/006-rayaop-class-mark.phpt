@@ -0,0 +1,41 @@
+--TEST--
+RayAOP intercepts classes declared after registration only
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Intercepted: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+class UntouchedClass {
+    public function testMethod($arg) {
+        return "Untouched: " . $arg;
+    }
+}
+
+// Register before the class exists
+method_intercept('LateClass', 'testMethod', new TestInterceptor());
+
+spl_autoload_register(function (string $class) {
+    if ($class === 'LateClass') {
+        eval('class LateClass { public function testMethod($arg) { return "Late: " . $arg; } public function otherMethod($arg) { return "Other: " . $arg; } }');
+    }
+});
+
+$untouched = new UntouchedClass();
+var_dump($untouched->testMethod("Hello"));
+
+$late = new LateClass();
+var_dump($late->testMethod("Hello"));
+var_dump($late->otherMethod("Hello"));
+
+?>
+--EXPECT--
+string(16) "Untouched: Hello"
+string(24) "Intercepted: Late: Hello"
+string(12) "Other: Hello"
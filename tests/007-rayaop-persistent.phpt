@@ -0,0 +1,63 @@
+--TEST--
+RayAOP persistent bindings
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function otherMethod($arg) {
+        return "Other: " . $arg;
+    }
+}
+
+class PersistentInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function __construct() {
+        echo "PersistentInterceptor constructed\n";
+    }
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Persistent: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+class RequestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Request: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+var_dump(method_intercept_persistent(TestClass::class, 'testMethod', PersistentInterceptor::class));
+var_dump(method_intercept_persistent(TestClass::class, 'otherMethod', PersistentInterceptor::class));
+var_dump(method_intercept_persistent(TestClass::class, 'missingHandler', 'NoSuchInterceptor'));
+echo "Registered\n";
+
+$test = new TestClass();
+var_dump($test->testMethod("Hello"));
+var_dump($test->otherMethod("Hello"));
+
+// Registering the same binding again changes nothing
+var_dump(method_intercept_persistent(TestClass::class, 'testMethod', PersistentInterceptor::class));
+var_dump($test->testMethod("Again"));
+
+// Request bindings take precedence
+method_intercept(TestClass::class, 'testMethod', new RequestInterceptor());
+var_dump($test->testMethod("Hello"));
+
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+Registered
+PersistentInterceptor constructed
+string(27) "Persistent: Original: Hello"
+string(24) "Persistent: Other: Hello"
+bool(true)
+string(27) "Persistent: Original: Again"
+string(24) "Request: Original: Hello"
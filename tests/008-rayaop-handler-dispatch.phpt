@@ -0,0 +1,50 @@
+--TEST--
+RayAOP dispatches to the interceptor resolved at registration time
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function magicMethod($arg) {
+        return "Magic: " . $arg;
+    }
+}
+
+class CountingInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public int $calls = 0;
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        $this->calls++;
+        return call_user_func_array([$object, $method], $params);
+    }
+}
+
+// Not an interceptor, but method_intercept() accepts any object
+class MagicInterceptor {
+    public function __call(string $name, array $arguments): mixed {
+        [$object, $method, $params] = $arguments;
+        return "__call(" . $name . "): " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+$counting = new CountingInterceptor();
+method_intercept(TestClass::class, 'testMethod', $counting);
+method_intercept(TestClass::class, 'magicMethod', new MagicInterceptor());
+
+$test = new TestClass();
+for ($i = 0; $i < 1000; $i++) {
+    $test->testMethod($i);
+}
+var_dump($counting->calls);
+var_dump($test->magicMethod("Hello"));
+
+?>
+--EXPECT--
+int(1000)
+string(31) "__call(intercept): Magic: Hello"
@@ -0,0 +1,72 @@
+--TEST--
+RayAOP native interceptors proceed through Ray\Aop\NativeMethodInvocation
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function greet($name, ...$rest) {
+        return "Hello " . $name . " " . json_encode($rest);
+    }
+
+    public function outer($arg) {
+        return "outer(" . $this->inner($arg) . ")";
+    }
+
+    public function inner($arg) {
+        return "inner(" . $arg . ")";
+    }
+}
+
+class TracingInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public ?Ray\Aop\NativeMethodInvocation $kept = null;
+
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        $this->kept = $invocation;
+        echo "before " . get_class($invocation->getThis()) . "::" . $invocation->getMethodName()
+            . " " . json_encode($invocation->getArguments()) . "\n";
+        $result = $invocation->proceed();
+        echo "after " . $invocation->getMethodName() . "\n";
+        return "[" . $result . "]";
+    }
+}
+
+class TwiceInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return $invocation->proceed() . " / " . $invocation->proceed();
+    }
+}
+
+$tracing = new TracingInterceptor();
+method_intercept(TestClass::class, 'greet', $tracing);
+method_intercept(TestClass::class, 'outer', $tracing);
+method_intercept(TestClass::class, 'inner', new TwiceInterceptor());
+
+$test = new TestClass();
+var_dump($test->greet("World", 1, 2, key: "value"));
+var_dump($test->outer("x"));
+
+try {
+    $tracing->kept->proceed();
+} catch (Error $e) {
+    echo $e->getMessage(), "\n";
+}
+
+try {
+    new Ray\Aop\NativeMethodInvocation();
+} catch (Error $e) {
+    echo $e->getMessage(), "\n";
+}
+
+?>
+--EXPECT--
+before TestClass::greet {"0":"World","1":1,"2":2,"key":"value"}
+after greet
+string(41) "[Hello World {"0":1,"1":2,"key":"value"}]"
+before TestClass::outer ["x"]
+after outer
+string(28) "[outer(inner(x) / inner(x))]"
+The invocation of this Ray\Aop\NativeMethodInvocation has already finished
+Cannot directly construct Ray\Aop\NativeMethodInvocation
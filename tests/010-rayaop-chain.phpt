@@ -0,0 +1,64 @@
+--TEST--
+RayAOP walks interceptor chains in order
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+}
+
+class NativeTag implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function __construct(private string $tag) {}
+
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return $this->tag . "(" . $invocation->proceed() . ")";
+    }
+}
+
+class ClassicTag implements Ray\Aop\MethodInterceptorInterface {
+    public function __construct(private string $tag) {}
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        $params[0] .= "!";
+        return $this->tag . "(" . call_user_func_array([$object, $method], $params) . ")";
+    }
+}
+
+$a = new NativeTag("A");
+$b = new ClassicTag("B");
+$c = new NativeTag("C");
+
+var_dump(method_intercept_append(TestClass::class, 'testMethod', $b));
+var_dump(method_intercept_append(TestClass::class, 'testMethod', $c));
+var_dump(method_intercept_prepend(TestClass::class, 'testMethod', $a));
+
+$test = new TestClass();
+echo $test->testMethod("x"), "\n";
+
+var_dump(method_intercept_remove(TestClass::class, 'testMethod', $b));
+var_dump(method_intercept_remove(TestClass::class, 'testMethod', $b));
+echo $test->testMethod("x"), "\n";
+
+method_intercept(TestClass::class, 'testMethod', $b);
+echo $test->testMethod("x"), "\n";
+
+var_dump(method_intercept_remove(TestClass::class, 'testMethod', $b));
+echo $test->testMethod("x"), "\n";
+
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+A(B(C(Original: x!)))
+bool(true)
+bool(false)
+A(C(Original: x))
+B(Original: x!)
+bool(true)
+Original: x
@@ -0,0 +1,71 @@
+--TEST--
+RayAOP native interceptors read arguments through Ray\Aop\ArgumentView
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($first, $second = "default", ...$rest) {
+        return "Original: " . $first;
+    }
+}
+
+class ViewInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public ?Ray\Aop\ArgumentView $kept = null;
+
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        $args = $invocation->getArgumentView();
+        var_dump($args === $invocation->getArgumentView());
+        var_dump(count($args));
+        var_dump($args[0], $args['first'], $args['1'], $args['second'], $args[2], $args['extra']);
+        var_dump(isset($args[5]), isset($args['rest']));
+        var_dump($args->toArray());
+        try {
+            $args[0] = "changed";
+        } catch (Error $e) {
+            echo $e->getMessage(), "\n";
+        }
+        $this->kept = $args;
+        return $invocation->proceed();
+    }
+}
+
+$interceptor = new ViewInterceptor();
+method_intercept(TestClass::class, 'testMethod', $interceptor);
+
+$test = new TestClass();
+var_dump($test->testMethod("a", "b", "c", extra: "d"));
+
+try {
+    $interceptor->kept[0];
+} catch (Error $e) {
+    echo $e->getMessage(), "\n";
+}
+
+?>
+--EXPECT--
+bool(true)
+int(4)
+string(1) "a"
+string(1) "a"
+string(1) "b"
+string(1) "b"
+string(1) "c"
+string(1) "d"
+bool(false)
+bool(false)
+array(4) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(1) "b"
+  [2]=>
+  string(1) "c"
+  ["extra"]=>
+  string(1) "d"
+}
+Ray\Aop\ArgumentView is read-only
+string(12) "Original: a"
+The invocation of this Ray\Aop\ArgumentView has already finished
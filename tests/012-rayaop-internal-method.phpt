@@ -0,0 +1,36 @@
+--TEST--
+RayAOP intercepts internal methods when rayaop.intercept_internal is enabled
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.intercept_internal=1
+--FILE--
+<?php
+class CountInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return 10 * call_user_func_array([$object, $method], $params);
+    }
+}
+
+class OffsetInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        $key = $invocation->getArgumentView()['key'];
+        return strtoupper($key) . "=" . $invocation->proceed();
+    }
+}
+
+method_intercept(ArrayObject::class, 'count', new CountInterceptor());
+method_intercept(ArrayObject::class, 'offsetGet', new OffsetInterceptor());
+
+$object = new ArrayObject(['a' => 'apple', 'b' => 'banana']);
+var_dump($object->count());
+var_dump($object->offsetGet('b'));
+var_dump($object->getArrayCopy() === ['a' => 'apple', 'b' => 'banana']);
+
+?>
+--EXPECT--
+int(20)
+string(8) "B=banana"
+bool(true)
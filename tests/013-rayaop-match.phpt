@@ -0,0 +1,74 @@
+--TEST--
+RayAOP binds matching methods when a class is first used
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+namespace App\Attribute {
+    #[\Attribute]
+    class Transactional {}
+}
+
+namespace App\Service {
+    use App\Attribute\Transactional;
+
+    class UserService {
+        #[Transactional]
+        public function save($name) { return "save " . $name; }
+        public function findUser($id) { return "user " . $id; }
+        public static function create() { return "static"; }
+    }
+
+    #[Transactional]
+    class OrderService {
+        public function place($id) { return "order " . $id; }
+    }
+}
+
+namespace App\Repository {
+    class UserRepository {
+        public function findUser($id) { return "row " . $id; }
+    }
+}
+
+namespace {
+    class Tag implements Ray\Aop\NativeMethodInterceptorInterface {
+        public function __construct(private string $tag) {}
+
+        public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+            return $this->tag . "(" . $invocation->proceed() . ")";
+        }
+    }
+
+    $repository = new App\Repository\UserRepository();
+    var_dump($repository->findUser(1)); // Called before any matcher exists
+
+    var_dump(method_intercept_match('App\Service\*', 'find*', new Tag("log")));
+    var_dump(method_intercept_match('*', '*', new Tag("tx"), App\Attribute\Transactional::class));
+    var_dump(method_intercept_match('\App\Repository\User*', 'FIND?SER', new Tag("repo")));
+
+    $users = new App\Service\UserService();
+    var_dump($users->save("alice"));
+    var_dump($users->findUser(2));
+    var_dump(App\Service\UserService::create());
+    var_dump((new App\Service\OrderService())->place(3));
+    var_dump($repository->findUser(4));
+
+    // Classes that were already matched are matched again immediately
+    method_intercept_match('App\Service\UserService', 'save', new Tag("late"));
+    var_dump($users->save("bob"));
+}
+?>
+--EXPECT--
+string(5) "row 1"
+bool(true)
+bool(true)
+bool(true)
+string(14) "tx(save alice)"
+string(11) "log(user 2)"
+string(6) "static"
+string(11) "tx(order 3)"
+string(11) "repo(row 4)"
+string(18) "tx(late(save bob))"
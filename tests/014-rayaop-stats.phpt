@@ -0,0 +1,60 @@
+--TEST--
+RayAOP collects per-binding call statistics when rayaop.stats is enabled
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.stats=1
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        usleep(1000);
+        return "Original: " . $arg;
+    }
+
+    public function plainMethod() {
+        return "plain";
+    }
+}
+
+class SlowInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        usleep(1000);
+        return $invocation->proceed();
+    }
+}
+
+method_intercept(TestClass::class, 'testMethod', new SlowInterceptor());
+
+$test = new TestClass();
+for ($i = 0; $i < 3; $i++) {
+    $test->testMethod($i);
+    $test->plainMethod();
+}
+
+$stats = rayaop_stats(true);
+$binding = $stats['bindings']['TestClass::testMethod'];
+var_dump($stats['enabled']);
+var_dump($stats['rejected'] >= 3);
+var_dump($binding['calls']);
+var_dump($binding['original_time'] >= 3000000);
+var_dump($binding['interceptor_time'] >= 3000000);
+var_dump($binding['total_time'] === $binding['original_time'] + $binding['interceptor_time']);
+var_dump($binding['max_time'] >= $binding['max_original_time']);
+
+$stats = rayaop_stats();
+var_dump($stats['bindings']['TestClass::testMethod']['calls'], $stats['rejected']);
+
+?>
+--EXPECT--
+bool(true)
+bool(true)
+int(3)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(0)
+int(0)
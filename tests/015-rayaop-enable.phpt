@@ -0,0 +1,71 @@
+--TEST--
+RayAOP installs its hooks lazily and can be switched off with rayaop_disable()
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.lazy=1
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function callSecret($arg) {
+        return $this->secret($arg); // Compiled while no binding exists
+    }
+
+    private function secret($arg) {
+        return "Secret: " . $arg;
+    }
+}
+
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Intercepted: " . $object->$method(...$params);
+    }
+}
+
+$object = new TestClass();
+$interceptor = new TestInterceptor();
+
+// Idle: nothing registered
+echo $object->testMethod("idle"), "\n";
+
+method_intercept(TestClass::class, 'testMethod', $interceptor);
+method_intercept(TestClass::class, 'secret', $interceptor);
+echo $object->testMethod("active"), "\n";
+echo $object->callSecret("active"), "\n";
+
+var_dump(rayaop_disable());
+echo $object->testMethod("disabled"), "\n";
+echo $object->callSecret("disabled"), "\n";
+var_dump(rayaop_disable());
+
+var_dump(rayaop_enable());
+echo $object->testMethod("enabled"), "\n";
+
+// Removing the last bindings makes the request idle again
+method_intercept_remove(TestClass::class, 'testMethod', $interceptor);
+method_intercept_remove(TestClass::class, 'secret', $interceptor);
+echo $object->testMethod("removed"), "\n";
+echo $object->callSecret("removed"), "\n";
+
+method_intercept(TestClass::class, 'testMethod', $interceptor);
+echo $object->testMethod("again"), "\n";
+?>
+--EXPECT--
+Original: idle
+Intercepted: Original: active
+Intercepted: Secret: active
+bool(true)
+Original: disabled
+Secret: disabled
+bool(false)
+bool(false)
+Intercepted: Original: enabled
+Original: removed
+Secret: removed
+Intercepted: Original: again
@@ -0,0 +1,142 @@
+--TEST--
+RayAOP caches method results by argument with method_memoize()
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class Repository {
+    public $calls = 0;
+
+    public function find($id, $lang = 'en') {
+        $this->calls++;
+        return "$id-$lang-{$this->calls}";
+    }
+
+    public function count(array $items) {
+        $this->calls++;
+        return count($items);
+    }
+
+    public function fail($id) {
+        $this->calls++;
+        throw new RuntimeException("fail $id");
+    }
+
+    public function greet($name) {
+        return "Hello $name";
+    }
+}
+
+class Account {
+    public static $created = 0;
+
+    public function __construct(private string $owner) {}
+
+    public function label($id) {
+        return "{$this->owner}-$id";
+    }
+
+    public static function create($id) {
+        self::$created++;
+        return static::class . "-$id-" . self::$created;
+    }
+}
+
+class SavingsAccount extends Account {}
+
+class LoggingInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        echo "miss: $method\n";
+        return $object->$method(...$params);
+    }
+}
+
+$repository = new Repository();
+var_dump(method_memoize(Repository::class, 'find', ['max_entries' => 2]));
+
+// Hits, misses and least recently used eviction
+echo $repository->find(1), "\n";   // miss
+echo $repository->find(1), "\n";   // hit
+echo $repository->find("1"), "\n"; // miss: types are part of the key
+echo $repository->find(1), "\n";   // hit
+echo $repository->find(2), "\n";   // miss, evicts "1"
+echo $repository->find(1), "\n";   // hit
+echo $repository->find("1"), "\n"; // miss, evicts 2
+echo $repository->find(2), "\n";   // miss
+echo $repository->find(2, 'ja'), "\n";
+echo $repository->calls, "\n";
+
+// Calls with array arguments always proceed
+method_memoize(Repository::class, 'count');
+$repository->calls = 0;
+$repository->count([1, 2]);
+$repository->count([1, 2]);
+echo $repository->calls, "\n";
+
+// Exceptions are not cached
+method_memoize(Repository::class, 'fail');
+$repository->calls = 0;
+foreach ([1, 1] as $id) {
+    try {
+        $repository->fail($id);
+    } catch (RuntimeException $e) {
+        echo $e->getMessage(), "\n";
+    }
+}
+echo $repository->calls, "\n";
+
+// Cached results skip the interceptors after the memoizing binding
+method_intercept_append(Repository::class, 'greet', new LoggingInterceptor());
+method_memoize(Repository::class, 'greet');
+echo $repository->greet("World"), "\n";
+echo $repository->greet("World"), "\n";
+echo $repository->greet("PHP"), "\n";
+
+try {
+    method_memoize(Repository::class, 'find', ['max_entries' => 0]);
+} catch (ValueError $e) {
+    echo $e->getMessage(), "\n";
+}
+
+// Results are cached per object and per called class
+method_memoize(Account::class, 'label');
+method_memoize(Account::class, 'create');
+$alice = new Account('alice');
+$bob = new Account('bob');
+echo $alice->label(1), "\n";
+echo $bob->label(1), "\n";
+echo $alice->label(1), "\n";
+echo Account::create(1), "\n";
+echo SavingsAccount::create(1), "\n";
+echo Account::create(1), "\n";
+?>
+--EXPECT--
+bool(true)
+1-en-1
+1-en-1
+1-en-2
+1-en-1
+2-en-3
+1-en-1
+1-en-4
+2-en-5
+2-ja-6
+6
+2
+fail 1
+fail 1
+2
+miss: greet
+Hello World
+Hello World
+miss: greet
+Hello PHP
+method_memoize(): Argument #3 ($options) option "max_entries" must be greater than 0
+alice-1
+bob-1
+alice-1
+Account-1-1
+SavingsAccount-1-2
+Account-1-1
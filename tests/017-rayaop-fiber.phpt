@@ -0,0 +1,72 @@
+--TEST--
+RayAOP keeps interception state per fiber when an interceptor suspends
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class Service {
+    public function run($name) {
+        return "run $name";
+    }
+}
+
+class SuspendingInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        echo "before {$params[0]}\n";
+        Fiber::suspend();
+        $result = $object->$method(...$params);
+        echo "after {$params[0]}\n";
+        return "intercepted: $result";
+    }
+}
+
+class NativeSuspendingInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        Fiber::suspend();
+        return "native: " . $invocation->proceed();
+    }
+}
+
+$service = new Service();
+method_intercept(Service::class, 'run', new SuspendingInterceptor());
+
+// The same method on the same object, while the first interceptor is suspended
+$a = new Fiber(function () use ($service) { echo $service->run('a'), "\n"; });
+$b = new Fiber(function () use ($service) { echo $service->run('b'), "\n"; });
+$a->start();
+$b->start();
+$a->resume();
+$b->resume();
+
+// Fibers finishing in reverse order
+method_intercept(Service::class, 'run', new NativeSuspendingInterceptor());
+$fibers = [];
+foreach (['x', 'y', 'z'] as $name) {
+    $fibers[$name] = new Fiber(function () use ($service, $name) { echo $service->run($name), "\n"; });
+    $fibers[$name]->start();
+}
+foreach (array_reverse($fibers) as $fiber) {
+    $fiber->resume();
+}
+
+// Interception outside fibers is unaffected
+method_intercept(Service::class, 'run', new class implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "main: " . $object->$method(...$params);
+    }
+});
+echo $service->run('main'), "\n";
+?>
+--EXPECT--
+before a
+before b
+after a
+intercepted: run a
+after b
+intercepted: run b
+native: run z
+native: run y
+native: run x
+main: run main
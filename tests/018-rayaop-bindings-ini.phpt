@@ -0,0 +1,53 @@
+--TEST--
+RayAOP loads persistent bindings from rayaop.bindings at startup
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.bindings="TestClass::testMethod=StartupInterceptor, \TestClass::otherMethod=StartupInterceptor"
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function otherMethod($arg) {
+        return "Other: " . $arg;
+    }
+
+    public function plainMethod($arg) {
+        return "Plain: " . $arg;
+    }
+}
+
+class StartupInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Startup: " . $object->$method(...$params);
+    }
+}
+
+class RuntimeInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Runtime: " . $object->$method(...$params);
+    }
+}
+
+$test = new TestClass();
+var_dump($test->testMethod("Hello"));
+var_dump($test->otherMethod("Hello"));
+var_dump($test->plainMethod("Hello"));
+
+// Bindings added at run time extend the startup registry
+var_dump(method_intercept_persistent(TestClass::class, 'plainMethod', RuntimeInterceptor::class));
+var_dump($test->plainMethod("Hello"));
+var_dump($test->testMethod("Hello"));
+?>
+--EXPECT--
+string(24) "Startup: Original: Hello"
+string(21) "Startup: Other: Hello"
+string(12) "Plain: Hello"
+bool(true)
+string(21) "Runtime: Plain: Hello"
+string(24) "Startup: Original: Hello"
@@ -0,0 +1,66 @@
+--TEST--
+RayAOP registers many bindings at once with method_intercept_many()
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class Service {
+    public function a() { return "a"; }
+    public function b() { return "b"; }
+}
+
+class TagInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function __construct(private string $tag) {}
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "{$this->tag}(" . $object->$method(...$params) . ")";
+    }
+}
+
+$outer = new TagInterceptor('outer');
+$inner = new TagInterceptor('inner');
+var_dump(method_intercept_many([
+    [Service::class, 'a', $outer],
+    [Service::class, 'a', $inner],
+    ['Service', 'b', $outer],
+]));
+
+$service = new Service();
+echo $service->a(), "\n";
+echo $service->b(), "\n";
+
+// Many bindings, removed and registered again (released chains are reused)
+$bindings = [];
+for ($i = 0; $i < 1000; $i++) {
+    $bindings[] = ["Missing$i", 'run', $outer];
+}
+var_dump(method_intercept_many($bindings));
+for ($i = 0; $i < 1000; $i++) {
+    method_intercept_remove("Missing$i", 'run', $outer);
+}
+var_dump(method_intercept_many($bindings));
+var_dump(method_intercept_remove(Service::class, 'a', $inner));
+echo $service->a(), "\n";
+
+// Nothing is registered if an element is invalid
+try {
+    method_intercept_many([[Service::class, 'b', $inner], [Service::class, 'b']]);
+} catch (TypeError $e) {
+    echo $e->getMessage(), "\n";
+}
+echo $service->b(), "\n";
+var_dump(method_intercept_many([]));
+?>
+--EXPECT--
+int(3)
+outer(inner(a))
+outer(b)
+int(1000)
+int(1000)
+bool(true)
+outer(a)
+method_intercept_many(): Argument #1 ($bindings) must contain only [string $class_name, string $method_name, object $interceptor] lists
+outer(b)
+int(0)
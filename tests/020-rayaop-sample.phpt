@@ -0,0 +1,67 @@
+--TEST--
+RayAOP intercepts a random sample of calls with method_intercept_sample()
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class Service {
+    public function run($i) {
+        return $i;
+    }
+}
+
+class CountingInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public $calls = 0;
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        $this->calls++;
+        return $object->$method(...$params) * 10; // The proceed is never sampled out
+    }
+}
+
+$service = new Service();
+$interceptor = new CountingInterceptor();
+var_dump(method_intercept_sample(Service::class, 'run', 4)); // Not bound yet
+
+method_intercept(Service::class, 'run', $interceptor);
+var_dump(method_intercept_sample(Service::class, 'run', 4));
+
+$sum = 0;
+for ($i = 0; $i < 4000; $i++) {
+    $sum += $service->run(1);
+}
+var_dump($interceptor->calls > 700 && $interceptor->calls < 1300);
+var_dump($sum === 4000 + 9 * $interceptor->calls);
+
+// The rate survives a new chain
+$replacement = new CountingInterceptor();
+method_intercept(Service::class, 'run', $replacement);
+for ($i = 0; $i < 4000; $i++) {
+    $service->run(1);
+}
+var_dump($replacement->calls > 700 && $replacement->calls < 1300);
+
+// A rate of 1 intercepts every call
+method_intercept_sample(Service::class, 'run', 1);
+$replacement->calls = 0;
+for ($i = 0; $i < 100; $i++) {
+    $service->run(1);
+}
+var_dump($replacement->calls);
+
+try {
+    method_intercept_sample(Service::class, 'run', 0);
+} catch (ValueError $e) {
+    echo $e->getMessage(), "\n";
+}
+?>
+--EXPECT--
+bool(false)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(100)
+method_intercept_sample(): Argument #3 ($rate) must be between 1 and 4294967295
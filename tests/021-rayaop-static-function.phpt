@@ -0,0 +1,93 @@
+--TEST--
+RayAOP intercepts static methods and functions
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--INI--
+rayaop.intercept_internal=1
+--FILE--
+<?php
+class Factory {
+    public static function create($name) {
+        return static::class . "($name)";
+    }
+
+    public static function build($name) {
+        return static::create($name);
+    }
+}
+
+class ChildFactory extends Factory {
+}
+
+function greet($name) {
+    return "Hello $name";
+}
+
+function twice($text) {
+    return str_repeat($text, 2);
+}
+
+class NativeTracer implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        echo "native ", var_export($invocation->getThis(), true), " ", var_export($invocation->getClassName(), true),
+            " ", $invocation->getMethodName(), "\n";
+        return "<" . $invocation->proceed() . ">";
+    }
+}
+
+class ClassicTracer implements Ray\Aop\MethodInterceptorInterface {
+    // The object is widened to receive the class of a static method and null for a function
+    public function intercept(object|string|null $object, string $method, array $params): mixed {
+        echo "classic ", var_export($object, true), " $method\n";
+        $callable = $object === null ? $method : [$object, $method];
+        return "[" . call_user_func_array($callable, $params) . "]";
+    }
+}
+
+// Static methods: the class of the call is passed instead of an object
+method_intercept(Factory::class, 'create', new NativeTracer());
+echo Factory::create('a'), "\n";
+echo ChildFactory::build('b'), "\n";
+
+method_intercept(Factory::class, 'create', new ClassicTracer());
+echo ChildFactory::create('c'), "\n";
+
+// Functions are bound under the empty class name
+var_dump(function_intercept('\greet', new NativeTracer()));
+echo greet('World'), "\n";
+method_intercept_append('', 'greet', new ClassicTracer());
+echo greet('PHP'), "\n";
+$name = 'greet';
+echo $name('dynamic'), "\n";
+
+// Internal functions (rayaop.intercept_internal)
+function_intercept('str_repeat', new ClassicTracer());
+echo twice('ab'), "\n";
+
+var_dump(method_intercept_remove('', 'greet', new ClassicTracer()));
+method_intercept('', 'greet', new ClassicTracer());
+echo greet('again'), "\n";
+?>
+--EXPECT--
+native NULL 'Factory' create
+<Factory(a)>
+native NULL 'ChildFactory' create
+<ChildFactory(b)>
+classic 'ChildFactory' create
+[ChildFactory(c)]
+bool(true)
+native NULL NULL greet
+<Hello World>
+native NULL NULL greet
+classic NULL greet
+<[Hello PHP]>
+native NULL NULL greet
+classic NULL greet
+<[Hello dynamic]>
+classic NULL str_repeat
+[abab]
+bool(false)
+classic NULL greet
+[Hello again]
@@ -0,0 +1,90 @@
+--TEST--
+RayAOP binds interceptors to individual objects with method_intercept_object()
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+?>
+--FILE--
+<?php
+class Service {
+    public function run($name) {
+        return "run $name";
+    }
+
+    public function __destruct() {
+        echo "destruct\n";
+    }
+}
+
+class TagInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function __construct(private string $tag) {}
+
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "{$this->tag}(" . $object->$method(...$params) . ")";
+    }
+}
+
+class NativeTagInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function __construct(private string $tag) {}
+
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return "{$this->tag}(" . $invocation->proceed() . ")";
+    }
+}
+
+$a = new Service();
+$b = new Service();
+$object = new NativeTagInterceptor('object');
+
+// Only the bound object is intercepted
+var_dump(method_intercept_object($a, 'RUN', $object));
+echo $a->run('a'), "\n";
+echo $b->run('b'), "\n";
+
+// Object interceptors run before the class-level chain
+method_intercept(Service::class, 'run', new TagInterceptor('class'));
+echo $a->run('a'), "\n";
+echo $b->run('b'), "\n";
+method_intercept_object($a, 'run', new TagInterceptor('second'));
+echo $a->run('a'), "\n";
+
+// Removing interceptors of the object
+var_dump(method_intercept_object_remove($a, 'run', $object));
+var_dump(method_intercept_object_remove($a, 'run', $object));
+var_dump(method_intercept_object_remove($b, 'run', $object));
+echo $a->run('a'), "\n";
+
+// Bindings are released with the object
+$c = new Service();
+method_intercept_object($c, 'run', new NativeTagInterceptor('c'));
+echo $c->run('c'), "\n";
+unset($c);
+$d = new Service();
+echo $d->run('d'), "\n";
+
+try {
+    method_intercept_object($b, 'missing', $object);
+} catch (ValueError $e) {
+    echo $e->getMessage(), "\n";
+}
+echo "done\n";
+?>
+--EXPECT--
+bool(true)
+object(run a)
+run b
+object(class(run a))
+class(run b)
+object(second(class(run a)))
+bool(true)
+bool(false)
+bool(false)
+second(class(run a))
+c(class(run c))
+destruct
+class(run d)
+method_intercept_object(): Argument #2 ($method_name) must be the name of a non-static method of Service
+done
+destruct
+destruct
+destruct
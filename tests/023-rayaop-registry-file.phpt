@@ -0,0 +1,83 @@
+--TEST--
+RayAOP exports bindings with rayaop_registry_export() and loads them with rayaop.registry_file
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+if (!getenv('TEST_PHP_EXECUTABLE')) die('skip TEST_PHP_EXECUTABLE not set');
+?>
+--FILE--
+<?php
+class Service {
+    public function run($name) {
+        return "run $name";
+    }
+
+    public function plain($name) {
+        return "plain $name";
+    }
+
+    public function chained($name) {
+        return "chained $name";
+    }
+}
+
+function render($name) {
+    return "render $name";
+}
+
+class TagInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return "tag(" . $invocation->proceed() . ")";
+    }
+}
+
+$image = __DIR__ . '/023-rayaop-registry.bin';
+
+if (($argv[1] ?? '') === 'child') {
+    $service = new Service();
+    echo $service->run('a'), "\n";
+    echo $service->plain('b'), "\n";
+    echo $service->chained('c'), "\n";
+    echo render('d'), "\n";
+    exit;
+}
+
+function run_child($image) {
+    $command = escapeshellarg(getenv('TEST_PHP_EXECUTABLE')) . ' ' . getenv('TEST_PHP_EXTRA_ARGS')
+        . ' -d rayaop.registry_file=' . escapeshellarg($image) . ' ' . escapeshellarg(__FILE__) . ' child 2>&1';
+    echo shell_exec($command);
+}
+
+method_intercept(Service::class, 'run', new TagInterceptor());
+function_intercept('render', new TagInterceptor());
+method_intercept_persistent(Service::class, 'plain', TagInterceptor::class);
+
+// Chains cannot be rebuilt from a class name and are left out
+method_intercept_append(Service::class, 'chained', new TagInterceptor());
+method_intercept_append(Service::class, 'chained', new TagInterceptor());
+
+var_dump(rayaop_registry_export($image));
+echo "-- warm start\n";
+run_child($image);
+
+file_put_contents($image, 'garbage');
+echo "-- invalid image\n";
+run_child($image);
+?>
+--CLEAN--
+<?php
+@unlink(__DIR__ . '/023-rayaop-registry.bin');
+?>
+--EXPECTF--
+int(3)
+-- warm start
+tag(run a)
+tag(plain b)
+chained c
+tag(render d)
+-- invalid image
+%AInvalid rayaop.registry_file "%s023-rayaop-registry.bin", regenerate it with rayaop_registry_export()%A
+run a
+plain b
+chained c
+render d
@@ -0,0 +1,40 @@
+--TEST--
+RayAOP leaves the execution hooks and the compiled opcodes untouched in an idle request
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+if (!extension_loaded('Zend OPcache')) die('skip opcache not loaded');
+?>
+--INI--
+opcache.enable=1
+opcache.enable_cli=1
+opcache.file_update_protection=0
+opcache.opt_debug_level=0x10000
+--FILE--
+<?php
+function helper($arg) {
+    return "helper " . $arg;
+}
+
+function caller() {
+    return helper("idle"); // Resolved at compile time
+}
+
+function hooks() {
+    ob_start();
+    (new ReflectionExtension('rayaop'))->info();
+    preg_match('/Execution hooks => (\w+)/', ob_get_clean(), $m);
+    return $m[1];
+}
+
+var_dump(ini_get('rayaop.lazy'));
+echo hooks(), "\n";
+echo caller(), "\n";
+eval('echo hooks(), "\n";'); // Compiling does not swap the hooks
+?>
+--EXPECTF--
+%Acaller:%AINIT_FCALL 1 %d string("helper")%ADO_%cCALL%A
+string(1) "0"
+installed
+helper idle
+%Ainstalled
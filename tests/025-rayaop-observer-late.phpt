@@ -0,0 +1,93 @@
+--TEST--
+RayAOP observer backend intercepts functions that were called before their binding was registered
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+if (PHP_VERSION_ID < 80200) die('skip observer handlers cannot be added during a request before PHP 8.2');
+?>
+--INI--
+rayaop.backend=observer
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function objectMethod($arg) {
+        return "Object: " . $arg;
+    }
+
+    public function matchedMethod($arg) {
+        return "Matched: " . $arg;
+    }
+
+    public function persistentMethod($arg) {
+        return "Persistent: " . $arg;
+    }
+
+    public function disabledMethod($arg) {
+        return "Disabled: " . $arg;
+    }
+}
+
+function helper($arg) {
+    return "Helper: " . $arg;
+}
+
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object|string|null $object, string $method, array $params): mixed {
+        $callable = $object === null ? $method : [$object, $method];
+        return "Intercepted: " . call_user_func_array($callable, $params);
+    }
+}
+
+class NativeInterceptor implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return "Native: " . $invocation->proceed();
+    }
+}
+
+$test = new TestClass();
+
+// Each function is observed (without handlers) by its first call
+echo $test->testMethod("before"), "\n";
+method_intercept(TestClass::class, 'testMethod', new TestInterceptor());
+echo $test->testMethod("after"), "\n";
+
+echo $test->objectMethod("before"), "\n";
+method_intercept_object($test, 'objectMethod', new NativeInterceptor());
+echo $test->objectMethod("after"), "\n";
+
+echo $test->matchedMethod("before"), "\n";
+method_intercept_match('TestClass', 'matched*', new NativeInterceptor());
+echo $test->matchedMethod("after"), "\n";
+
+echo $test->persistentMethod("before"), "\n";
+method_intercept_persistent(TestClass::class, 'persistentMethod', NativeInterceptor::class);
+echo $test->persistentMethod("after"), "\n";
+
+echo helper("before"), "\n";
+function_intercept('helper', new TestInterceptor());
+echo helper("after"), "\n";
+
+// First called while interception is switched off
+method_intercept(TestClass::class, 'disabledMethod', new NativeInterceptor());
+rayaop_disable();
+echo $test->disabledMethod("disabled"), "\n";
+rayaop_enable();
+echo $test->disabledMethod("enabled"), "\n";
+?>
+--EXPECT--
+Original: before
+Intercepted: Original: after
+Object: before
+Native: Object: after
+Matched: before
+Native: Matched: after
+Persistent: before
+Native: Persistent: after
+Helper: before
+Intercepted: Helper: after
+Disabled: disabled
+Native: Disabled: enabled
@@ -0,0 +1,42 @@
+--TEST--
+RayAOP observer backend warns about bindings of functions that were called before on PHP 8.1
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+if (PHP_VERSION_ID >= 80200) die('skip observer handlers are added during the request since PHP 8.2');
+?>
+--INI--
+rayaop.backend=observer
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function otherMethod($arg) {
+        return "Other: " . $arg;
+    }
+}
+
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Intercepted: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+$test = new TestClass();
+echo $test->testMethod("before"), "\n";
+method_intercept(TestClass::class, 'testMethod', new TestInterceptor());
+echo $test->testMethod("after"), "\n";
+
+// Not called yet: intercepted without a warning
+method_intercept(TestClass::class, 'otherMethod', new TestInterceptor());
+echo $test->otherMethod("first"), "\n";
+?>
+--EXPECTF--
+Original: before
+
+Warning: method_intercept(): TestClass::testMethod() has been called before its binding was registered, the observer backend intercepts it from the next request on in %s on line %d
+Original: after
+Intercepted: Other: first
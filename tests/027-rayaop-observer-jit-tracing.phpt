@@ -0,0 +1,86 @@
+--TEST--
+RayAOP observer backend with opcache JIT (tracing)
+--SKIPIF--
+<?php
+if (!extension_loaded('rayaop')) die('skip rayaop extension not available');
+if (!extension_loaded('Zend OPcache')) die('skip opcache not loaded');
+?>
+--INI--
+rayaop.backend=observer
+opcache.enable=1
+opcache.enable_cli=1
+opcache.file_update_protection=0
+opcache.jit=tracing
+opcache.jit_buffer_size=16M
+opcache.jit_hot_func=1
+opcache.jit_hot_loop=1
+opcache.jit_hot_return=1
+opcache.jit_hot_side_exit=1
+--FILE--
+<?php
+class TestClass {
+    public function testMethod($arg) {
+        return "Original: " . $arg;
+    }
+
+    public function otherMethod($arg) {
+        return "Other: " . $arg;
+    }
+}
+
+class Counter {
+    public static int $calls = 0;
+
+    public function hit() {
+        self::$calls++;
+        return "hit";
+    }
+}
+
+class ShortCircuit implements Ray\Aop\NativeMethodInterceptorInterface {
+    public function invoke(Ray\Aop\NativeMethodInvocation $invocation): mixed {
+        return "skipped";
+    }
+}
+
+class TestInterceptor implements Ray\Aop\MethodInterceptorInterface {
+    public function intercept(object $object, string $method, array $params): mixed {
+        return "Intercepted: " . call_user_func_array([$object, $method], $params);
+    }
+}
+
+var_dump(ini_get('rayaop.backend'));
+method_intercept(TestClass::class, 'testMethod', new TestInterceptor());
+
+$test = new TestClass();
+var_dump($test->testMethod("Hello"));
+var_dump($test->testMethod("World"));
+var_dump($test->otherMethod("Hello"));
+$test->testMethod("Unused result");
+
+// Hot enough to be compiled by the JIT
+$results = [];
+for ($i = 0; $i < 200; $i++) {
+    $results[$test->testMethod("Loop") . " / " . $test->otherMethod("Loop")] = true;
+}
+var_dump(array_keys($results));
+
+// The original body never runs when the interceptor does not proceed
+method_intercept(Counter::class, 'hit', new ShortCircuit());
+$counter = new Counter();
+for ($i = 0; $i < 200; $i++) {
+    $result = $counter->hit();
+}
+echo $result, " ", Counter::$calls, "\n";
+
+?>
+--EXPECT--
+string(8) "observer"
+string(28) "Intercepted: Original: Hello"
+string(28) "Intercepted: Original: World"
+string(12) "Other: Hello"
+array(1) {
+  [0]=>
+  string(41) "Intercepted: Original: Loop / Other: Loop"
+}
+skipped 0